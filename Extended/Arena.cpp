@@ -0,0 +1,68 @@
+#include <GL/glew.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <assert.h>
+
+#include "Arena.h"
+
+using namespace std;
+
+static const size_t ARENA_BLOCK_SIZE = 1 << 20;
+static const size_t ARENA_ALIGNMENT = 16;
+
+void* arenaAlloc(geometryArena *arena, size_t bytes){
+    bytes = (bytes + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+
+    // Move on to the first recycled block with room left
+    while (arena->block < arena->blocks.size()){
+        if (arena->used + bytes <= arena->blockSizes[arena->block]){
+            void *ptr = arena->blocks[arena->block] + arena->used;
+            arena->used += bytes;
+            return ptr;
+        }
+        arena->block++;
+        arena->used = 0;
+    }
+
+    // Large meshes get a block of their own
+    size_t size = max(bytes, ARENA_BLOCK_SIZE);
+    char *block = (char*)malloc(size);
+    assert(block != NULL && "Could not allocate memory for geometry arena");
+    arena->blocks.push_back(block);
+    arena->blockSizes.push_back(size);
+    arena->block = arena->blocks.size() - 1;
+    arena->used = bytes;
+    return block;
+}
+
+GLfloat* arenaFloats(geometryArena *arena, size_t count){
+    return (GLfloat*)arenaAlloc(arena, count * sizeof(GLfloat));
+}
+
+GLfloat* arenaFloats(geometryArena *arena, initializer_list<GLfloat> values){
+    GLfloat *array = arenaFloats(arena, values.size());
+    copy(values.begin(), values.end(), array);
+    return array;
+}
+
+void arenaReset(geometryArena *arena){
+    arena->block = 0;
+    arena->used = 0;
+}
+
+void arenaRelease(geometryArena *arena){
+    for (size_t i = 0; i < arena->blocks.size(); i++)
+        free(arena->blocks[i]);
+    arena->blocks.clear();
+    arena->blockSizes.clear();
+    arenaReset(arena);
+}
+
+size_t arenaCapacity(geometryArena const *arena){
+    size_t total = 0;
+    for (size_t i = 0; i < arena->blockSizes.size(); i++)
+        total += arena->blockSizes[i];
+    return total;
+}
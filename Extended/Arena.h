@@ -0,0 +1,34 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <vector>
+#include <initializer_list>
+
+// Bump allocator for CPU-side geometry. Build a load's (or a frame's)
+// objects from one arena, upload them, then reset the arena: every
+// allocation is dropped at once and the blocks are recycled for the next
+// load, so no mesh size is capped and nothing lingers after upload.
+struct geometryArena {
+    std::vector<char*> blocks;
+    std::vector<size_t> blockSizes;
+    size_t block;  // Index of the block being filled
+    size_t used;   // Bytes used in that block
+};
+
+void* arenaAlloc(geometryArena *arena, size_t bytes);
+
+GLfloat* arenaFloats(geometryArena *arena, size_t count);
+GLfloat* arenaFloats(geometryArena *arena, std::initializer_list<GLfloat> values);
+
+// Drops all allocations but keeps the blocks for reuse
+void arenaReset(geometryArena *arena);
+
+// Drops all allocations and frees the blocks
+void arenaRelease(geometryArena *arena);
+
+size_t arenaCapacity(geometryArena const *arena);
+
+#endif
@@ -0,0 +1,244 @@
+#ifdef WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#endif
+
+#include <GL/glew.h>
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <assert.h>
+
+#include "Atlas.h"
+#include "State.h"
+#include "TextureLoader.h"
+
+using namespace std;
+
+// Texels of repeated edge around each packed image
+static const GLsizei ATLAS_PADDING = 2;
+
+// One horizontal segment of the skyline: everything below y is taken
+struct skylineNode {
+    GLsizei x;
+    GLsizei y;
+    GLsizei width;
+};
+
+int atlasAdd(textureAtlas *atlas, const char *file_name){
+    atlas->images.push_back(atlasImage());
+    atlasImage *image = &atlas->images.back();
+    if (!decodePNG(file_name, &image->width, &image->height, &image->pixels)){
+        cerr << "Fatal: Could not read PNG " << file_name << endl;
+        exit(EXIT_FAILURE);
+    }
+    return atlas->images.size() - 1;
+}
+
+// Lowest y where a width x height rectangle fits with its left edge at node
+// i, or -1 if it does not fit there
+static GLsizei skylineFit(vector<skylineNode> const& skyline, size_t i, GLsizei width,
+                          GLsizei height, GLsizei pageSize){
+    if (skyline[i].x + width > pageSize) return -1;
+
+    GLsizei y = 0;
+    for (GLsizei left = width; left > 0; i++){
+        y = max(y, skyline[i].y);
+        if (y + height > pageSize) return -1;
+        left -= skyline[i].width;
+    }
+    return y;
+}
+
+// Bottom-left skyline packing, false if the layer is full
+static bool skylineInsert(vector<skylineNode> *skyline, GLsizei width, GLsizei height,
+                          GLsizei pageSize, GLsizei *x, GLsizei *y){
+    size_t best = skyline->size();
+    GLsizei bestY = 0;
+    for (size_t i = 0; i < skyline->size(); i++){
+        GLsizei fitY = skylineFit(*skyline, i, width, height, pageSize);
+        if (fitY >= 0 && (best == skyline->size() || fitY < bestY)){
+            best = i;
+            bestY = fitY;
+        }
+    }
+    if (best == skyline->size()) return false;
+
+    *x = (*skyline)[best].x;
+    *y = bestY;
+    skylineNode node = {*x, bestY + height, width};
+    skyline->insert(skyline->begin() + best, node);
+
+    // Cut away what the new node now covers
+    GLsizei end = node.x + node.width;
+    for (size_t i = best + 1; i < skyline->size() && (*skyline)[i].x < end;){
+        GLsizei covered = end - (*skyline)[i].x;
+        if (covered >= (*skyline)[i].width){
+            skyline->erase(skyline->begin() + i);
+        } else {
+            (*skyline)[i].x += covered;
+            (*skyline)[i].width -= covered;
+            break;
+        }
+    }
+
+    for (size_t i = 0; i + 1 < skyline->size();){
+        if ((*skyline)[i].y == (*skyline)[i + 1].y){
+            (*skyline)[i].width += (*skyline)[i + 1].width;
+            skyline->erase(skyline->begin() + i + 1);
+        } else {
+            i++;
+        }
+    }
+    return true;
+}
+
+// Copies the image with its edge texels repeated ATLAS_PADDING times
+static void padImage(atlasImage const& image, vector<GLubyte> *padded){
+    GLsizei width = image.width + 2 * ATLAS_PADDING;
+    GLsizei height = image.height + 2 * ATLAS_PADDING;
+    padded->resize((size_t)width * height * 4);
+
+    for (GLsizei y = 0; y < height; y++){
+        GLsizei sourceY = min(max(y - ATLAS_PADDING, 0), image.height - 1);
+        for (GLsizei x = 0; x < width; x++){
+            GLsizei sourceX = min(max(x - ATLAS_PADDING, 0), image.width - 1);
+            const GLubyte *from = &image.pixels[((size_t)sourceY * image.width + sourceX) * 4];
+            copy(from, from + 4, padded->begin() + ((size_t)y * width + x) * 4);
+        }
+    }
+}
+
+// Images larger than a layer cannot go in the atlas whichever way it packs
+static void checkFits(atlasImage const& image, GLsizei padding, GLsizei maxSize){
+    if (image.width + 2 * padding > maxSize || image.height + 2 * padding > maxSize){
+        cerr << "Fatal: Image of " << image.width << "x" << image.height
+             << " does not fit an atlas of " << maxSize << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+static bool tallerFirst(atlasImage const* a, atlasImage const* b){
+    if (a->height != b->height) return a->height > b->height;
+    return a->width > b->width;
+}
+
+void buildAtlas(textureAtlas *atlas, GLsizei maxSize){
+    vector<atlasImage> &images = atlas->images;
+    assert(!images.empty() && "Atlas has no images");
+
+    GLint maxTextureSize, maxLayers;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+    maxSize = min(maxSize, (GLsizei)maxTextureSize);
+
+    bool uniform = true;
+    for (size_t i = 1; i < images.size(); i++)
+        uniform = uniform && images[i].width == images[0].width && images[i].height == images[0].height;
+
+    vector<GLsizei> x(images.size(), 0), y(images.size(), 0), layer(images.size(), 0);
+    GLsizei padding = uniform ? 0 : ATLAS_PADDING;
+
+    if (uniform){
+        checkFits(images[0], padding, maxSize);
+        atlas->width = images[0].width;
+        atlas->height = images[0].height;
+        atlas->layers = images.size();
+        for (size_t i = 0; i < images.size(); i++) layer[i] = i;
+    } else {
+        vector<atlasImage*> order;
+        for (size_t i = 0; i < images.size(); i++) order.push_back(&images[i]);
+        sort(order.begin(), order.end(), tallerFirst); // Packs tighter
+
+        vector< vector<skylineNode> > skylines;
+        atlas->width = atlas->height = 0;
+        for (size_t n = 0; n < order.size(); n++){
+            size_t i = order[n] - &images[0];
+            checkFits(images[i], padding, maxSize);
+            GLsizei width = images[i].width + 2 * padding;
+            GLsizei height = images[i].height + 2 * padding;
+
+            size_t l = 0;
+            while (l < skylines.size() && !skylineInsert(&skylines[l], width, height, maxSize, &x[i], &y[i]))
+                l++;
+            if (l == skylines.size()){
+                skylineNode empty = {0, 0, maxSize};
+                skylines.push_back(vector<skylineNode>(1, empty));
+                skylineInsert(&skylines[l], width, height, maxSize, &x[i], &y[i]);
+            }
+            layer[i] = l;
+
+            // Layers are trimmed to what was used
+            atlas->width = max(atlas->width, x[i] + width);
+            atlas->height = max(atlas->height, y[i] + height);
+        }
+        atlas->layers = skylines.size();
+    }
+    // Checked for both ways of packing, before anything is allocated
+    if (atlas->layers > maxLayers){
+        cerr << "Fatal: Atlas needs " << atlas->layers << " layers, the limit is " << maxLayers << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // Zeroed first, so the gutters between images are defined
+    vector<GLubyte> clear((size_t)atlas->width * atlas->height * atlas->layers * 4, 0);
+    stateGenTextures(1, &atlas->texture, "atlas");
+    stateBindTexture(0, GL_TEXTURE_2D_ARRAY, atlas->texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, atlas->width, atlas->height, atlas->layers,
+                 0, GL_RGBA, GL_UNSIGNED_BYTE, clear.data());
+    stateTextureBytes(atlas->texture, clear.size());
+
+    vector<GLubyte> padded;
+    atlas->regions.resize(images.size());
+    for (size_t i = 0; i < images.size(); i++){
+        const GLubyte *pixels = images[i].pixels.data();
+        if (padding){
+            padImage(images[i], &padded);
+            pixels = padded.data();
+        }
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x[i], y[i], layer[i],
+                        images[i].width + 2 * padding, images[i].height + 2 * padding, 1,
+                        GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+        atlasRegion region;
+        region.u0 = (GLfloat)(x[i] + padding) / atlas->width;
+        region.v0 = (GLfloat)(y[i] + padding) / atlas->height;
+        region.u1 = (GLfloat)(x[i] + padding + images[i].width) / atlas->width;
+        region.v1 = (GLfloat)(y[i] + padding + images[i].height) / atlas->height;
+        region.layer = layer[i];
+        atlas->regions[i] = region;
+    }
+
+    // Whole layers can still repeat, packed regions would wrap into others
+    GLint wrap = uniform ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+    images.clear();
+    images.shrink_to_fit();
+}
+
+void remapUVs(textureAtlas const* atlas, int region, struct texturePolygon *obj){
+    assert(obj->uvBufferArray != NULL && "remapUVs needs the UVs, call it before uploadArray");
+    atlasRegion const& r = atlas->regions[region];
+
+    for (GLuint i = 0; i < obj->arrayLength; i++){
+        GLfloat *uv = obj->uvBufferArray + i * 2;
+        uv[0] = r.u0 + uv[0] * (r.u1 - r.u0);
+        uv[1] = r.v0 + uv[1] * (r.v1 - r.v0);
+    }
+    obj->texture = atlas->texture;
+    obj->layer = r.layer;
+}
+
+void deleteAtlas(textureAtlas *atlas){
+    stateDeleteTextures(1, &atlas->texture);
+    atlas->texture = 0;
+    atlas->images.clear();
+    atlas->regions.clear();
+}
@@ -0,0 +1,47 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <GL/glew.h>
+
+#include <vector>
+
+#include "Render.h"
+
+// Many images packed into one GL_TEXTURE_2D_ARRAY, so polygons using any of
+// them can share a bind and a draw (see textureBatch in Batch.h). Images of
+// one common size get a layer each and keep GL_REPEAT working. Mixed sizes
+// are packed with a skyline packer into as many layers as they need, with
+// edge pixels repeated into a padding gutter against filtering bleed.
+struct atlasImage {
+    GLsizei width;
+    GLsizei height;
+    std::vector<GLubyte> pixels; // RGBA8, bottom row first
+};
+
+struct atlasRegion {
+    GLfloat u0, v0, u1, v1;
+    GLfloat layer;
+};
+
+struct textureAtlas {
+    GLuint texture; // GL_TEXTURE_2D_ARRAY, once built
+    GLsizei width;
+    GLsizei height;
+    GLsizei layers;
+    std::vector<atlasImage> images; // Only until buildAtlas
+    std::vector<atlasRegion> regions;
+};
+
+// Decodes a PNG and returns its region index, valid after buildAtlas
+int atlasAdd(textureAtlas *atlas, const char *file_name);
+
+// Packs the images into layers of at most maxSize x maxSize and uploads them
+void buildAtlas(textureAtlas *atlas, GLsizei maxSize);
+
+// Maps the polygon's 0..1 UVs into the region and points it at the atlas.
+// Call before uploadArray, while uvBufferArray is still set.
+void remapUVs(textureAtlas const* atlas, int region, struct texturePolygon *obj);
+
+void deleteAtlas(textureAtlas *atlas);
+
+#endif
@@ -0,0 +1,196 @@
+#ifdef WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#endif
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Batch.h"
+#include "State.h"
+
+using namespace std;
+
+// Position and color, three floats each. Textured batches hold position,
+// UV and layer in the same six floats.
+static const int BATCH_STRIDE = 6;
+
+void batchArray(vector<arrayBatch> *batches, struct arrayObject *obj){
+    arrayBatch *batch = NULL;
+    for (size_t i = 0; i < batches->size(); i++){
+        // Uploaded batches are full, their buffer is sized for what they hold
+        if ((*batches)[i].vertexBuffer != 0) continue;
+        if ((*batches)[i].shader == obj->shader && (*batches)[i].mode == obj->mode){
+            batch = &(*batches)[i];
+            break;
+        }
+    }
+
+    if (batch == NULL){
+        arrayBatch newBatch;
+        newBatch.shader = obj->shader;
+        newBatch.mode = obj->mode;
+        newBatch.vertexBuffer = 0;
+        newBatch.vertexArrayID = 0;
+        newBatch.vertexCount = 0;
+        batches->push_back(newBatch);
+        batch = &batches->back();
+    }
+
+    GLsizei vertices = obj->vertexArrayLength / 3;
+    batch->objects.push_back(obj);
+    batch->first.push_back(batch->vertexCount);
+    batch->count.push_back(vertices);
+    batch->vertexCount += vertices;
+}
+
+void uploadBatches(vector<arrayBatch> *batches){
+    vector<GLfloat> packed;
+
+    for (size_t b = 0; b < batches->size(); b++){
+        arrayBatch *batch = &(*batches)[b];
+        if (batch->vertexBuffer != 0) continue; // Uploaded by an earlier call
+        packed.resize(batch->vertexCount * BATCH_STRIDE);
+
+        for (size_t i = 0; i < batch->objects.size(); i++){
+            arrayObject *obj = batch->objects[i];
+            GLfloat *out = &packed[batch->first[i] * BATCH_STRIDE];
+            for (GLsizei v = 0; v < batch->count[i]; v++){
+                out[v * BATCH_STRIDE + 0] = obj->vertexArray[v * 3 + 0];
+                out[v * BATCH_STRIDE + 1] = obj->vertexArray[v * 3 + 1];
+                out[v * BATCH_STRIDE + 2] = obj->vertexArray[v * 3 + 2];
+                out[v * BATCH_STRIDE + 3] = obj->colorVec.x;
+                out[v * BATCH_STRIDE + 4] = obj->colorVec.y;
+                out[v * BATCH_STRIDE + 5] = obj->colorVec.z;
+            }
+            obj->vertexArray = NULL;
+        }
+        batch->objects.clear();
+
+        stateGenBuffers(1, &batch->vertexBuffer, "batch");
+        stateBindBuffer(GL_ARRAY_BUFFER, batch->vertexBuffer);
+        stateBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * packed.size(),
+                     packed.data(), GL_STATIC_DRAW);
+
+        glGenVertexArrays(1, &batch->vertexArrayID);
+        stateBindVertexArray(batch->vertexArrayID);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, BATCH_STRIDE * sizeof(GLfloat), (void*)0);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, BATCH_STRIDE * sizeof(GLfloat),
+                              (void*)(3 * sizeof(GLfloat)));
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(2);
+    }
+}
+
+void drawBatches(vector<arrayBatch> *batches){
+    for (size_t b = 0; b < batches->size(); b++){
+        arrayBatch *batch = &(*batches)[b];
+        stateUseProgram(batch->shader);
+
+        stateBindVertexArray(batch->vertexArrayID);
+        glMultiDrawArrays(batch->mode, batch->first.data(), batch->count.data(),
+                          batch->first.size());
+    }
+
+    // Read per vertex here, drawArray sets it as a constant
+    if (!batches->empty()) stateInvalidateAttribute(2);
+}
+
+void deleteBatches(vector<arrayBatch> *batches){
+    for (size_t b = 0; b < batches->size(); b++){
+        stateDeleteBuffers(1, &(*batches)[b].vertexBuffer);
+        stateDeleteVertexArrays(1, &(*batches)[b].vertexArrayID);
+    }
+    batches->clear();
+}
+
+void batchTexture(vector<textureBatch> *batches, struct texturePolygon *obj){
+    textureBatch *batch = NULL;
+    for (size_t i = 0; i < batches->size(); i++){
+        if ((*batches)[i].vertexBuffer != 0) continue;
+        if ((*batches)[i].shader == obj->shader && (*batches)[i].texture == obj->texture){
+            batch = &(*batches)[i];
+            break;
+        }
+    }
+
+    if (batch == NULL){
+        textureBatch newBatch;
+        newBatch.shader = obj->shader;
+        newBatch.texture = obj->texture;
+        newBatch.textureID = glGetUniformLocation(obj->shader, "myTextureSampler");
+        newBatch.vertexBuffer = 0;
+        newBatch.vertexArrayID = 0;
+        newBatch.vertexCount = 0;
+        batches->push_back(newBatch);
+        batch = &batches->back();
+    }
+
+    batch->polygons.push_back(obj);
+    batch->vertexCount += obj->arrayLength;
+}
+
+void uploadBatches(vector<textureBatch> *batches){
+    vector<GLfloat> packed;
+
+    for (size_t b = 0; b < batches->size(); b++){
+        textureBatch *batch = &(*batches)[b];
+        if (batch->vertexBuffer != 0) continue; // Uploaded by an earlier call
+        packed.resize(batch->vertexCount * BATCH_STRIDE);
+
+        GLfloat *out = packed.data();
+        for (size_t i = 0; i < batch->polygons.size(); i++){
+            texturePolygon *obj = batch->polygons[i];
+            for (GLuint v = 0; v < obj->arrayLength; v++, out += BATCH_STRIDE){
+                out[0] = obj->vertexBufferArray[v * 3 + 0];
+                out[1] = obj->vertexBufferArray[v * 3 + 1];
+                out[2] = obj->vertexBufferArray[v * 3 + 2];
+                out[3] = obj->uvBufferArray[v * 2 + 0];
+                out[4] = obj->uvBufferArray[v * 2 + 1];
+                out[5] = obj->layer;
+            }
+            obj->vertexBufferArray = NULL;
+            obj->uvBufferArray = NULL;
+        }
+        batch->polygons.clear();
+
+        stateGenBuffers(1, &batch->vertexBuffer, "batch");
+        stateBindBuffer(GL_ARRAY_BUFFER, batch->vertexBuffer);
+        stateBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * packed.size(),
+                     packed.data(), GL_STATIC_DRAW);
+
+        GLsizei stride = BATCH_STRIDE * sizeof(GLfloat);
+        glGenVertexArrays(1, &batch->vertexArrayID);
+        stateBindVertexArray(batch->vertexArrayID);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(GLfloat)));
+        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride, (void*)(5 * sizeof(GLfloat)));
+        for (GLuint i = 0; i <= 2; i++) glEnableVertexAttribArray(i);
+    }
+}
+
+void drawBatches(vector<textureBatch> *batches){
+    for (size_t b = 0; b < batches->size(); b++){
+        textureBatch *batch = &(*batches)[b];
+        stateUseProgram(batch->shader);
+
+        stateBindTexture(0, GL_TEXTURE_2D_ARRAY, batch->texture);
+        stateUniform1i(batch->shader, batch->textureID, 0);
+
+        stateBindVertexArray(batch->vertexArrayID);
+        glDrawArrays(GL_TRIANGLES, 0, batch->vertexCount);
+    }
+
+    // Read per vertex here, drawArray sets it as a constant
+    if (!batches->empty()) stateInvalidateAttribute(2);
+}
+
+void deleteBatches(vector<textureBatch> *batches){
+    for (size_t b = 0; b < batches->size(); b++){
+        stateDeleteBuffers(1, &(*batches)[b].vertexBuffer);
+        stateDeleteVertexArrays(1, &(*batches)[b].vertexArrayID);
+    }
+    batches->clear();
+}
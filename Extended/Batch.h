@@ -0,0 +1,55 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <GL/glew.h>
+
+#include <vector>
+
+#include "Render.h"
+
+// Objects sharing a shader and primitive mode, packed into one VBO of
+// interleaved position and color, and drawn with a single glMultiDrawArrays.
+struct arrayBatch {
+    GLuint shader;
+    GLuint mode;
+    GLuint vertexBuffer;
+    GLuint vertexArrayID;
+    std::vector<struct arrayObject*> objects; // Only until uploadBatches
+    std::vector<GLint> first;
+    std::vector<GLsizei> count;
+    GLsizei vertexCount;
+};
+
+// Adds an object that has not been uploaded yet. It is drawn through its
+// batch from then on, and its own vertexBuffer stays unused.
+void batchArray(std::vector<arrayBatch> *batches, struct arrayObject *obj);
+
+// Packs and uploads every batch, then drops the objects' CPU geometry like
+// uploadArray does. The color is baked into the vertices here. A batch is
+// uploaded once and later calls skip it; objects batched after that go
+// into a new batch, which costs another draw rather than a re-upload.
+void uploadBatches(std::vector<arrayBatch> *batches);
+
+void drawBatches(std::vector<arrayBatch> *batches);
+void deleteBatches(std::vector<arrayBatch> *batches);
+
+// Textured polygons sharing a shader and a texture array, usually an atlas
+// (Atlas.h), packed into one VBO of position, UV and layer and drawn with a
+// single glDrawArrays. Use the textureArray shaders with it.
+struct textureBatch {
+    GLuint shader;
+    GLuint texture;
+    GLint textureID;
+    GLuint vertexBuffer;
+    GLuint vertexArrayID;
+    std::vector<struct texturePolygon*> polygons; // Only until uploadBatches
+    GLsizei vertexCount;
+};
+
+// Uploaded once, like arrayBatch
+void batchTexture(std::vector<textureBatch> *batches, struct texturePolygon *obj);
+void uploadBatches(std::vector<textureBatch> *batches);
+void drawBatches(std::vector<textureBatch> *batches);
+void deleteBatches(std::vector<textureBatch> *batches);
+
+#endif
@@ -0,0 +1,923 @@
+// Rendering benchmark. Builds synthetic scenes of points, lines, triangles
+// and textured quads out of arrayObject/texturePolygon, scaled from 10^2 to
+// 10^6 primitives, and reports frame rate, frame time percentiles, draw
+// calls per frame, GL state calls per frame (issued and redundant) and
+// upload bandwidth. Runs headless so it works on any Linux box with Mesa
+// llvmpipe.
+//
+//   ./benchmark [--frames N] [--max PRIMITIVES] [--per-object PRIMITIVES]
+//               [--batch] [--instanced] [--stream[=persistent|unsynchronized|orphan]]
+//               [--atlas] [--indexed] [--compact] [--cull] [--gpu-cull] [--jobs THREADS]
+//               [--lod BUDGET] [--objects] [--pool]
+//               [--dynamic-resolution TARGET_MS] [--render-scale S]
+//               [--no-state-cache] [--shader-cache DIR|none]
+//               [--texture-cache DIR|none] [--compress-textures] [--csv FILE]
+//               [--headless=osmesa]
+
+#ifdef WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+    #include <GL/glew.h>
+    #include <OpenGL/gl.h>
+#else
+    #include <GL/glew.h>
+    #include <GL/gl.h>
+#endif
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <assert.h>
+
+#include "Arena.h"
+#include "Atlas.h"
+#include "Batch.h"
+#include "BufferPool.h"
+#include "Context.h"
+#include "DrawList.h"
+#include "GPUCull.h"
+#include "Jobs.h"
+#include "Mesh.h"
+#include "PointLOD.h"
+#include "ProgramCache.h"
+#include "Render.h"
+#include "Resolution.h"
+#include "State.h"
+#include "Stream.h"
+#include "TextureCache.h"
+#include "TextureLoader.h"
+#include "Uniforms.h"
+
+using namespace std;
+
+typedef chrono::steady_clock benchClock;
+
+enum benchKind { BENCH_POINTS, BENCH_LINES, BENCH_TRIANGLES, BENCH_QUADS };
+
+static const char* kindNames[] = {"points", "lines", "triangles", "quads"};
+
+static const int WARMUP_FRAMES = 5;
+static const float PRIMITIVE_SIZE = 6.0f;
+static const int ATLAS_IMAGES = 16; // Copies of test.png, one per layer
+static const int MESH_GRID = 256;   // Quads per side of the --indexed grid
+static const int CULL_WORLD = 8;    // --cull spreads objects over this many screens each way,
+static const float CULL_CLUSTER = 64.0f; // keeping each object's primitives this close
+static const float CULL_CELL = 128.0f;
+static const long JOB_GRAIN = 1024; // Objects per --jobs piece
+static const int POOL_RANGES = 20000; // Allocations in the --pool fragmentation test
+
+struct benchScene {
+    vector<arrayObject> arrays;
+    vector<texturePolygon> polygons;
+    vector<arrayBatch> batches; // Holds the arrays with --batch
+    vector<indirectBatch> indirectBatches; // Holds them with --gpu-cull
+    vector<instancedObject> instanced; // Replaces both with --instanced
+    vector<textureBatch> textureBatches; // Holds the polygons with --atlas
+    vector<indexedMesh> meshes; // Replace the polygons with --indexed
+    size_t uploadBytes;
+    // Objects drawn one by one. --cull and --jobs decide which are visible,
+    // record them in commands and replay those.
+    drawKind objectKind;
+    long objectCount;
+    bool recording;
+    drawList commands;
+    bounds2D view;
+    cullGrid grid; // Holds the objects with --cull
+    vector<void*> visible;
+    double cullMs;
+    size_t drawn;
+    bool lod;
+    pointCloud cloud; // Replaces the point arrays with --lod
+    objectBuffer objects; // The arrays' transforms with --objects
+    vector<bounds2D> movedBounds; // And their bounds under them, culled instead
+};
+
+struct benchResult {
+    benchKind kind;
+    long primitives;
+    size_t drawCalls;
+    double fps;
+    double p50, p95, p99;
+    double uploadMBps;
+    double stateCalls, redundantCalls; // Per frame
+    double cullMs; // Per frame
+};
+
+static long primitivesPerObject = 1000;
+static bool batching = false;
+static bool instancing = false;
+static bool streaming = false;
+static bool atlasing = false;
+static bool indexing = false;
+static bool compacting = false;
+static bool culling = false;
+static bool gpuCulling = false; // Arrays are culled by cullObjects.comp, the rest like --cull
+static int jobThreads = -1; // Workers for --jobs, -1 draws from the GL thread alone
+static GLuint lodBudget = 0; // Points drawn per frame with --lod, 0 draws them all
+static bool movingObjects = false;
+static bool pooling = false; // Arrays and meshes sub-allocate from the buffer pool
+static streamMode benchStreamMode = STREAM_AUTO;
+static geometryArena benchArena;
+
+static GLuint colorShader;
+static GLuint textureShader;
+static GLuint colorInstancedShader;
+static GLuint textureInstancedShader;
+static GLuint textureArrayShader;
+static GLuint pointLODShader;
+static GLuint colorObjectShader;
+static GLuint texture;
+static textureAtlas benchAtlas;
+static glm::mat4 sceneMVP; // MVP before --cull pans it
+static long cameraFrame = 0;
+static long objectFrame = 0;
+
+static double elapsedMs(benchClock::time_point start){
+    return chrono::duration<double, milli>(benchClock::now() - start).count();
+}
+
+static double percentile(vector<double> values, double p){
+    sort(values.begin(), values.end());
+    size_t n = values.size();
+    return values[min(n - 1, (size_t)(p * n))];
+}
+
+static void addVertex(arrayObject *obj, glm::vec2 pos){
+    obj->vertexArray[obj->vertexArrayLength++] = pos.x;
+    obj->vertexArray[obj->vertexArrayLength++] = pos.y;
+    obj->vertexArray[obj->vertexArrayLength++] = 0.0f;
+}
+
+static void addVertex(texturePolygon *obj, glm::vec2 pos, glm::vec2 uv){
+    obj->vertexBufferArray[obj->arrayLength * 3 + 0] = pos.x;
+    obj->vertexBufferArray[obj->arrayLength * 3 + 1] = pos.y;
+    obj->vertexBufferArray[obj->arrayLength * 3 + 2] = 0.0f;
+    obj->uvBufferArray[obj->arrayLength * 2 + 0] = uv.x;
+    obj->uvBufferArray[obj->arrayLength * 2 + 1] = uv.y;
+    obj->arrayLength++;
+}
+
+// One unit primitive per object, repeated primitivesPerObject times
+static void buildInstancedScene(benchScene *scene, benchKind kind, long primitives){
+    minstd_rand rng(1); // Same seed and positions as buildScene
+    uniform_real_distribution<float> x(-width / 2.0f, width / 2.0f - PRIMITIVE_SIZE);
+    uniform_real_distribution<float> y(-height / 2.0f, height / 2.0f - PRIMITIVE_SIZE);
+
+    GLuint modes[] = {GL_POINTS, GL_LINES, GL_TRIANGLES, GL_TRIANGLES};
+    GLuint vertexCounts[] = {1, 2, 3, 6};
+    GLfloat unitVertices[] = {0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f,
+                              0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f};
+    GLfloat triangleVertices[] = {0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f};
+    GLfloat unitUVs[] = {0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f,
+                         0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f};
+    GLfloat scale = kind == BENCH_POINTS ? 1.0f : PRIMITIVE_SIZE;
+
+    for (long i = 0; i < primitives; i += primitivesPerObject){
+        instancedObject obj = {modes[kind], colorInstancedShader};
+        obj.vertexCount = vertexCounts[kind];
+        obj.vertexArray = arenaFloats(&benchArena, obj.vertexCount * 3);
+        copy(kind == BENCH_TRIANGLES ? triangleVertices : unitVertices,
+             (kind == BENCH_TRIANGLES ? triangleVertices : unitVertices) + obj.vertexCount * 3,
+             obj.vertexArray);
+        if (kind == BENCH_QUADS){
+            obj.shader = textureInstancedShader;
+            obj.texture = texture;
+            obj.uvArray = arenaFloats(&benchArena, obj.vertexCount * 2);
+            copy(unitUVs, unitUVs + obj.vertexCount * 2, obj.uvArray);
+        }
+
+        obj.instanceCount = min(primitivesPerObject, primitives - i);
+        obj.instanceArray = arenaFloats(&benchArena, obj.instanceCount * INSTANCE_STRIDE);
+        for (GLuint n = 0; n < obj.instanceCount; n++){
+            GLfloat *instance = obj.instanceArray + n * INSTANCE_STRIDE;
+            instance[0] = x(rng);
+            instance[1] = y(rng);
+            instance[2] = scale;
+            instance[3] = 1.0f;
+            instance[4] = 1.0f;
+            instance[5] = 0.0f;
+        }
+
+        scene->uploadBytes += obj.vertexCount * (obj.uvArray ? 5 : 3) * sizeof(GLfloat) +
+                              obj.instanceCount * INSTANCE_STRIDE * sizeof(GLfloat);
+        scene->instanced.push_back(obj);
+    }
+}
+
+// Size of an array's vertices on the GPU
+static size_t arrayBytes(arrayObject const* obj){
+    return obj->vertexArrayLength / 3 * (obj->layout ? obj->layout->stride : 3 * sizeof(GLfloat));
+}
+
+// Packs primitivesPerObject primitives into each object, so the draw call
+// count is the primitive count divided by --per-object
+static void buildScene(benchScene *scene, benchKind kind, long primitives){
+    minstd_rand rng(1); // Fixed seed, every run draws the same scene
+    float spread = culling ? CULL_WORLD : 1.0f;
+    uniform_real_distribution<float> x(-width * spread / 2.0f, width * spread / 2.0f - PRIMITIVE_SIZE);
+    uniform_real_distribution<float> y(-height * spread / 2.0f, height * spread / 2.0f - PRIMITIVE_SIZE);
+    uniform_real_distribution<float> cluster(0.0f, CULL_CLUSTER);
+    glm::vec2 dx(PRIMITIVE_SIZE, 0.0f), dy(0.0f, PRIMITIVE_SIZE);
+    glm::vec2 center;
+
+    if (kind == BENCH_QUADS){
+        for (long i = 0; i < primitives; i++){
+            if (i % primitivesPerObject == 0){
+                size_t vertices = min(primitivesPerObject, primitives - i) * 6;
+                texturePolygon obj = {texture, textureShader};
+                obj.vertexBufferArray = arenaFloats(&benchArena, vertices * 3);
+                obj.uvBufferArray = arenaFloats(&benchArena, vertices * 2);
+                scene->polygons.push_back(obj);
+                if (culling) center = glm::vec2(x(rng), y(rng));
+            }
+            texturePolygon *obj = &scene->polygons.back();
+            glm::vec2 p = culling ? center + glm::vec2(cluster(rng), cluster(rng)) : glm::vec2(x(rng), y(rng));
+            addVertex(obj, p, glm::vec2(0.0f, 0.0f));
+            addVertex(obj, p + dx, glm::vec2(1.0f, 0.0f));
+            addVertex(obj, p + dx + dy, glm::vec2(1.0f, 1.0f));
+            addVertex(obj, p, glm::vec2(0.0f, 0.0f));
+            addVertex(obj, p + dx + dy, glm::vec2(1.0f, 1.0f));
+            addVertex(obj, p + dy, glm::vec2(0.0f, 1.0f));
+        }
+        if (indexing){
+            for (size_t i = 0; i < scene->polygons.size(); i++){
+                texturePolygon const& polygon = scene->polygons[i];
+                indexedMesh mesh = {texture, textureShader};
+                weldMesh(&mesh, &benchArena, polygon.vertexBufferArray, polygon.uvBufferArray,
+                         polygon.arrayLength);
+                optimizeMesh(&mesh);
+                mesh.layout = compacting ? &compactTextureLayout : NULL;
+                scene->uploadBytes += mesh.vertexCount * (mesh.layout ? mesh.layout->stride : MESH_STRIDE * sizeof(GLfloat)) +
+                    mesh.indexCount * (mesh.vertexCount <= 65536 ? sizeof(GLushort) : sizeof(GLuint));
+                scene->meshes.push_back(mesh);
+            }
+            scene->polygons.clear();
+            return;
+        }
+        for (size_t i = 0; i < scene->polygons.size(); i++){
+            texturePolygon *polygon = &scene->polygons[i];
+            polygon->layout = compacting ? &compactTextureLayout : NULL;
+            scene->uploadBytes += polygon->arrayLength * (polygon->layout ? polygon->layout->stride : 5 * sizeof(GLfloat));
+            if (atlasing){
+                scene->polygons[i].shader = textureArrayShader;
+                remapUVs(&benchAtlas, i % benchAtlas.regions.size(), &scene->polygons[i]);
+            }
+        }
+        return;
+    }
+
+    GLuint modes[] = {GL_POINTS, GL_LINES, GL_TRIANGLES};
+    int verticesPerPrimitive = kind + 1;
+    for (long i = 0; i < primitives; i++){
+        if (i % primitivesPerObject == 0){
+            size_t vertices = min(primitivesPerObject, primitives - i) * verticesPerPrimitive;
+            arrayObject obj = {modes[kind], colorShader, glm::vec3(1.0f, 1.0f, 0.0f)};
+            obj.vertexArray = arenaFloats(&benchArena, vertices * 3);
+            obj.layout = compacting ? &compactPositionLayout : NULL;
+            scene->arrays.push_back(obj);
+            if (culling) center = glm::vec2(x(rng), y(rng));
+        }
+        arrayObject *obj = &scene->arrays.back();
+        glm::vec2 p = culling ? center + glm::vec2(cluster(rng), cluster(rng)) : glm::vec2(x(rng), y(rng));
+        addVertex(obj, p);
+        if (kind >= BENCH_LINES) addVertex(obj, p + dx);
+        if (kind >= BENCH_TRIANGLES) addVertex(obj, p + dy);
+    }
+    for (size_t i = 0; i < scene->arrays.size(); i++)
+        scene->uploadBytes += arrayBytes(&scene->arrays[i]);
+}
+
+// Rewrites every array's vertices into this frame's stream region, as an
+// animated scene would
+static void streamScene(benchScene *scene, vertexStream *stream){
+    char *out = (char*)beginStream(stream, scene->uploadBytes);
+    size_t written = 0;
+    for (size_t i = 0; i < scene->arrays.size(); i++){
+        arrayObject *obj = &scene->arrays[i];
+        if (obj->layout){
+            const GLfloat *sources[] = {obj->vertexArray};
+            int strides[] = {3};
+            packVertices(*obj->layout, out + written, sources, strides, obj->vertexArrayLength / 3);
+        } else {
+            copy(obj->vertexArray, obj->vertexArray + obj->vertexArrayLength, (GLfloat*)(out + written));
+        }
+        obj->vertexOffset = written;
+        written += arrayBytes(obj);
+    }
+
+    GLintptr base = endStream(stream);
+    for (size_t i = 0; i < scene->arrays.size(); i++){
+        scene->arrays[i].vertexBuffer = stream->buffer;
+        scene->arrays[i].vertexOffset += base;
+        configureVertexArray(&scene->arrays[i]);
+    }
+}
+
+// Finds the objects that are drawn one by one, the arrays, textured polygons
+// or meshes when they are not batched
+static void findObjects(benchScene *scene){
+    scene->objectCount = 0;
+    if (!scene->meshes.empty()){
+        scene->objectKind = DRAW_ELEMENTS;
+        scene->objectCount = scene->meshes.size();
+    } else if (!scene->polygons.empty() && !atlasing){
+        scene->objectKind = DRAW_TEXTURE;
+        scene->objectCount = scene->polygons.size();
+    } else if (!scene->arrays.empty() && !batching && scene->indirectBatches.empty()){
+        scene->objectKind = DRAW_ARRAY;
+        scene->objectCount = scene->arrays.size();
+    }
+}
+
+static void *sceneObject(benchScene *scene, long i, bounds2D const** bounds){
+    switch (scene->objectKind){
+        case DRAW_ELEMENTS: *bounds = &scene->meshes[i].bounds; return &scene->meshes[i];
+        case DRAW_TEXTURE:  *bounds = &scene->polygons[i].bounds; return &scene->polygons[i];
+        default:
+            *bounds = scene->movedBounds.empty() ? &scene->arrays[i].bounds : &scene->movedBounds[i];
+            return &scene->arrays[i];
+    }
+}
+
+static void cullScene(benchScene *scene){
+    createCullGrid(&scene->grid, CULL_CELL);
+    for (long i = 0; i < scene->objectCount; i++){
+        bounds2D const* bounds;
+        void *obj = sceneObject(scene, i, &bounds);
+        cullInsert(&scene->grid, *bounds, obj);
+    }
+}
+
+// A --jobs piece: records the objects in [begin, end) that the view shows
+static void recordVisible(void *data, long begin, long end){
+    benchScene *scene = (benchScene*)data;
+    commandBuffer *buffer = beginDrawRun(&scene->commands, begin);
+    for (long i = begin; i < end; i++){
+        bounds2D const* bounds;
+        void *obj = sceneObject(scene, i, &bounds);
+        if (boundsOverlap(*bounds, scene->view)) recordDraw(buffer, scene->objectKind, obj);
+    }
+}
+
+// Pans across the world a little each frame, along a fixed path
+static void moveCamera(){
+    float reachX = (CULL_WORLD - 1) * width / 2.0f, reachY = (CULL_WORLD - 1) * height / 2.0f;
+    glm::vec3 offset(-reachX * sin(cameraFrame * 0.010f), -reachY * cos(cameraFrame * 0.013f), 0.0f);
+    MVP = glm::translate(sceneMVP, offset);
+    cameraFrame++;
+}
+
+// Sways every array with --objects, which only rewrites its transform and,
+// when the arrays are culled, their bounds. cullScene inserted array i as
+// handle i.
+static void moveObjects(benchScene *scene){
+    for (size_t i = 0; i < scene->arrays.size(); i++){
+        GLfloat phase = objectFrame * 0.05f + i;
+        glm::vec3 offset(8.0f * sin(phase), 8.0f * cos(phase), 0.0f);
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), offset);
+        setObjectModel(&scene->objects, scene->arrays[i].objectIndex, model);
+        if (scene->movedBounds.empty()) continue;
+        scene->movedBounds[i] = transformBounds(scene->arrays[i].bounds, model);
+        if (jobThreads < 0) cullMove(&scene->grid, i, scene->movedBounds[i]);
+    }
+    updateObjectBuffer(&scene->objects);
+    objectFrame++;
+}
+
+static void drawScene(benchScene *scene){
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    updateFrameUniforms();
+
+    if (scene->recording){
+        benchClock::time_point start = benchClock::now();
+        scene->view = visibleBounds(MVP, CULL_MARGIN);
+        resetDrawList(&scene->commands);
+        if (jobThreads >= 0){
+            parallelFor(scene->objectCount, JOB_GRAIN, recordVisible, scene);
+        } else {
+            cullQuery(&scene->grid, scene->view, &scene->visible);
+            commandBuffer *buffer = beginDrawRun(&scene->commands, 0);
+            for (size_t i = 0; i < scene->visible.size(); i++)
+                recordDraw(buffer, scene->objectKind, scene->visible[i]);
+        }
+        scene->cullMs += elapsedMs(start);
+        scene->drawn += replayDrawList(&scene->commands);
+        for (size_t i = 0; i < scene->instanced.size(); i++)
+            drawArrayInstanced(&scene->instanced[i]);
+        if (batching) drawBatches(&scene->batches);
+        drawBatches(&scene->indirectBatches);
+        if (atlasing) drawBatches(&scene->textureBatches);
+        return;
+    }
+
+    if (scene->lod){
+        benchClock::time_point start = benchClock::now();
+        selectPoints(&scene->cloud, MVP, visibleBounds(MVP, LOD_MAX_POINT_SIZE / 2.0f), lodBudget);
+        scene->cullMs += elapsedMs(start);
+        scene->drawn += scene->cloud.runs.size();
+        drawPointCloud(&scene->cloud);
+    }
+    if (atlasing) drawBatches(&scene->textureBatches);
+    else for (size_t i = 0; i < scene->polygons.size(); i++)
+        drawArrayTexture(&scene->polygons[i]);
+    for (size_t i = 0; i < scene->meshes.size(); i++)
+        drawElements(&scene->meshes[i]);
+    for (size_t i = 0; i < scene->instanced.size(); i++)
+        drawArrayInstanced(&scene->instanced[i]);
+    if (batching){
+        drawBatches(&scene->batches);
+    } else if (!scene->indirectBatches.empty()){
+        drawBatches(&scene->indirectBatches);
+    } else {
+        for (size_t i = 0; i < scene->arrays.size(); i++)
+            drawArray(&scene->arrays[i]);
+    }
+}
+
+// Draws the mesh once and returns how often the vertex shader ran, or 0
+// without ARB_pipeline_statistics_query
+static GLuint64 vertexShaderRuns(indexedMesh *mesh){
+    if (!GLEW_ARB_pipeline_statistics_query) return 0;
+
+    GLuint query;
+    GLuint64 runs = 0;
+    glGenQueries(1, &query);
+    glBeginQuery(GL_VERTEX_SHADER_INVOCATIONS_ARB, query);
+    drawElements(mesh);
+    glEndQuery(GL_VERTEX_SHADER_INVOCATIONS_ARB);
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &runs);
+    glDeleteQueries(1, &query);
+    return runs;
+}
+
+// A grid whose triangles come in random order, as exported meshes often
+// do. Reports the vertices welding saves, and the cache misses and vertex
+// shader runs that reordering saves on top.
+static void benchMesh(){
+    minstd_rand rng(1);
+    vector<GLuint> quads(MESH_GRID * MESH_GRID * 2);
+    for (size_t i = 0; i < quads.size(); i++) quads[i] = i;
+    shuffle(quads.begin(), quads.end(), rng);
+
+    GLuint vertexCount = quads.size() * 3;
+    GLfloat *positions = arenaFloats(&benchArena, vertexCount * 3);
+    GLfloat *uvs = arenaFloats(&benchArena, vertexCount * 2);
+    GLfloat corners[2][3][2] = {{{0, 0}, {1, 0}, {1, 1}}, {{0, 0}, {1, 1}, {0, 1}}};
+    GLfloat cell = (GLfloat)height / MESH_GRID;
+    for (size_t t = 0; t < quads.size(); t++){
+        GLuint quad = quads[t] / 2, half = quads[t] % 2;
+        for (int k = 0; k < 3; k++){
+            GLfloat x = quad % MESH_GRID + corners[half][k][0];
+            GLfloat y = quad / MESH_GRID + corners[half][k][1];
+            GLfloat *position = positions + (t * 3 + k) * 3;
+            position[0] = x * cell - height / 2.0f;
+            position[1] = y * cell - height / 2.0f;
+            position[2] = 0.0f;
+            uvs[(t * 3 + k) * 2] = x / MESH_GRID;
+            uvs[(t * 3 + k) * 2 + 1] = y / MESH_GRID;
+        }
+    }
+
+    indexedMesh meshes[2];
+    double missRatios[2];
+    GLuint64 runs[2];
+    updateFrameUniforms();
+    for (int optimized = 0; optimized < 2; optimized++){
+        indexedMesh &mesh = meshes[optimized];
+        mesh = indexedMesh();
+        mesh.texture = texture;
+        mesh.shader = textureShader;
+        weldMesh(&mesh, &benchArena, positions, uvs, vertexCount);
+        if (optimized) optimizeMesh(&mesh);
+        missRatios[optimized] = vertexCacheMissRatio(mesh.indexArray, mesh.indexCount, VERTEX_CACHE_SIZE);
+
+        if (!pooling){
+            stateGenBuffers(1, &mesh.vertexBuffer, "bench mesh");
+            stateGenBuffers(1, &mesh.indexBuffer, "bench mesh");
+        }
+        uploadArray(&mesh);
+        getUniform(&mesh);
+        runs[optimized] = vertexShaderRuns(&mesh);
+    }
+
+    cout << "# Indexed " << MESH_GRID << "x" << MESH_GRID << " grid: " << vertexCount << " -> "
+         << meshes[1].vertexCount << " vertices, " << fixed << setprecision(2)
+         << "cache misses per triangle " << missRatios[0] << " -> " << missRatios[1];
+    if (runs[0]) cout << ", vertex shader runs " << runs[0] << " -> " << runs[1];
+    cout << endl;
+
+    for (int i = 0; i < 2; i++) deleteArray(&meshes[i]);
+    arenaReset(&benchArena);
+}
+
+struct benchRange {
+    GLuint buffer;
+    GLintptr offset;
+};
+
+// Fills the pool with ranges of mixed sizes, frees every other one and
+// packs what is left, as a long-running scene that loads and drops objects
+static void benchPool(){
+    mt19937 rng(7);
+    uniform_int_distribution<int> size(64, 4096);
+    vector<benchRange> ranges(POOL_RANGES); // Never resized, the pool holds pointers into it
+    vector<char> data(4096, 0);
+    for (int i = 0; i < POOL_RANGES; i++){
+        GLsizeiptr bytes = size(rng);
+        poolAllocate(bytes, &ranges[i].buffer, &ranges[i].offset, NULL, NULL);
+        poolWrite(ranges[i].buffer, ranges[i].offset, bytes, data.data());
+    }
+    for (int i = 0; i < POOL_RANGES; i += 2) poolFree(ranges[i].buffer, ranges[i].offset);
+
+    poolStats before = poolStatistics();
+    glFinish();
+    benchClock::time_point start = benchClock::now();
+    size_t moved = defragmentPool();
+    glFinish();
+    double defragmentMs = elapsedMs(start);
+    poolStats after = poolStatistics();
+
+    cout << "# Pool " << POOL_RANGES << " ranges, half freed: " << before.blocks << " -> " << after.blocks
+         << " blocks, " << before.freeRanges << " -> " << after.freeRanges << " free ranges, "
+         << fixed << setprecision(2) << moved / (1024.0 * 1024.0) << " MB moved in "
+         << defragmentMs << " ms" << endl;
+
+    for (int i = 1; i < POOL_RANGES; i += 2) poolFree(ranges[i].buffer, ranges[i].offset);
+}
+
+static benchResult runCase(benchKind kind, long primitives, int frames){
+    benchScene *scene = new benchScene();
+    scene->uploadBytes = 0;
+    scene->recording = false;
+    if (instancing) buildInstancedScene(scene, kind, primitives);
+    else buildScene(scene, kind, primitives);
+
+    // --lod draws the points from one tree instead of object by object
+    vector<GLfloat> lodPoints;
+    scene->lod = lodBudget > 0 && kind == BENCH_POINTS && !scene->arrays.empty();
+    if (scene->lod){
+        for (size_t i = 0; i < scene->arrays.size(); i++){
+            arrayObject const& obj = scene->arrays[i];
+            lodPoints.insert(lodPoints.end(), obj.vertexArray, obj.vertexArray + obj.vertexArrayLength);
+        }
+        scene->cloud.shader = pointLODShader;
+        scene->cloud.colorVec = scene->arrays[0].colorVec;
+        scene->cloud.layout = scene->arrays[0].layout;
+        stateGenBuffers(1, &scene->cloud.vertexBuffer, "point cloud");
+        scene->arrays.clear();
+    }
+
+    // --gpu-cull packs the arrays into indirect batches, which neither move
+    // nor stream
+    bool indirect = gpuCulling && !batching;
+
+    // --objects moves the arrays through their transforms
+    bool moving = movingObjects && !batching && !indirect;
+    if (moving){
+        for (size_t i = 0; i < scene->arrays.size(); i++){
+            arrayObject *obj = &scene->arrays[i];
+            obj->shader = colorObjectShader;
+            obj->objectIndex = addObject(&scene->objects, glm::mat4(1.0f), obj->colorVec);
+        }
+    }
+
+    // Streamed arrays keep their CPU geometry and are uploaded every frame
+    bool streamArrays = streaming && !batching && !indirect && !scene->arrays.empty();
+    vertexStream stream;
+    if (streamArrays) createStream(&stream, scene->uploadBytes, benchStreamMode);
+
+    for (size_t i = 0; i < scene->arrays.size(); i++){
+        if (batching) batchArray(&scene->batches, &scene->arrays[i]);
+        else if (indirect) batchArray(&scene->indirectBatches, &scene->arrays[i]);
+        else if (!streamArrays && !pooling) stateGenBuffers(1, &scene->arrays[i].vertexBuffer, "bench array");
+    }
+    for (size_t i = 0; i < scene->polygons.size(); i++){
+        if (atlasing){
+            batchTexture(&scene->textureBatches, &scene->polygons[i]);
+            continue;
+        }
+        stateGenBuffers(1, &scene->polygons[i].vertexBuffer, "bench polygon");
+        if (!scene->polygons[i].layout) stateGenBuffers(1, &scene->polygons[i].uvBuffer, "bench polygon");
+    }
+    for (size_t i = 0; i < scene->meshes.size() && !pooling; i++){
+        stateGenBuffers(1, &scene->meshes[i].vertexBuffer, "bench mesh");
+        stateGenBuffers(1, &scene->meshes[i].indexBuffer, "bench mesh");
+    }
+    for (size_t i = 0; i < scene->instanced.size(); i++){
+        stateGenBuffers(1, &scene->instanced[i].vertexBuffer, "bench instanced");
+        stateGenBuffers(1, &scene->instanced[i].uvBuffer, "bench instanced");
+        stateGenBuffers(1, &scene->instanced[i].instanceBuffer, "bench instanced");
+    }
+
+    glFinish();
+    benchClock::time_point start = benchClock::now();
+    if (scene->lod) buildPointCloud(&scene->cloud, lodPoints.data(), lodPoints.size() / 3);
+    if (batching) uploadBatches(&scene->batches);
+    else if (indirect) uploadBatches(&scene->indirectBatches);
+    else if (!streamArrays) for (size_t i = 0; i < scene->arrays.size(); i++)
+        uploadArray(&scene->arrays[i]);
+    if (atlasing) uploadBatches(&scene->textureBatches);
+    else for (size_t i = 0; i < scene->polygons.size(); i++)
+        uploadArray(&scene->polygons[i]);
+    for (size_t i = 0; i < scene->meshes.size(); i++)
+        uploadArray(&scene->meshes[i]);
+    for (size_t i = 0; i < scene->instanced.size(); i++)
+        uploadArray(&scene->instanced[i]);
+    glFinish();
+    double uploadMs = elapsedMs(start);
+    if (!streamArrays) arenaReset(&benchArena); // The next case reuses the blocks
+
+    for (size_t i = 0; i < scene->arrays.size(); i++)
+        getUniform(&scene->arrays[i]);
+    for (size_t i = 0; i < scene->polygons.size(); i++)
+        getUniform(&scene->polygons[i]);
+    for (size_t i = 0; i < scene->meshes.size(); i++)
+        getUniform(&scene->meshes[i]);
+    if (scene->lod) getUniform(&scene->cloud);
+    findObjects(scene);
+    scene->recording = scene->objectCount > 0 && (culling || jobThreads >= 0);
+    if (scene->recording && moving && scene->objectKind == DRAW_ARRAY)
+        for (size_t i = 0; i < scene->arrays.size(); i++)
+            scene->movedBounds.push_back(scene->arrays[i].bounds);
+    if (scene->recording && jobThreads < 0) cullScene(scene);
+    for (size_t i = 0; i < scene->instanced.size(); i++)
+        getUniform(&scene->instanced[i]);
+
+    for (int i = 0; i < WARMUP_FRAMES; i++){
+        if (culling) moveCamera();
+        if (moving) moveObjects(scene);
+        if (streamArrays) streamScene(scene, &stream);
+        beginScaledFrame();
+        drawScene(scene);
+        endScaledFrame();
+        if (streamArrays) fenceStream(&stream);
+    }
+    glFinish();
+
+    // Finish every frame, so each sample is the full CPU+GPU frame time
+    vector<double> frameMs;
+    double streamMs = 0.0;
+    resetStateStatistics();
+    scene->cullMs = 0.0;
+    scene->drawn = 0;
+    start = benchClock::now();
+    for (int i = 0; i < frames; i++){
+        if (culling) moveCamera();
+        benchClock::time_point frameStart = benchClock::now();
+        if (moving) moveObjects(scene);
+        if (streamArrays){
+            streamScene(scene, &stream);
+            streamMs += elapsedMs(frameStart);
+        }
+        beginScaledFrame();
+        drawScene(scene);
+        endScaledFrame();
+        if (streamArrays) fenceStream(&stream);
+        glFinish();
+        frameMs.push_back(elapsedMs(frameStart));
+    }
+    double totalMs = elapsedMs(start);
+
+    // The last frame's cull, read back once the timing is done
+    if (!scene->indirectBatches.empty()){
+        bounds2D view = visibleBounds(MVP, CULL_MARGIN);
+        size_t expected = 0;
+        for (size_t i = 0; i < scene->arrays.size(); i++)
+            if (boundsOverlap(scene->arrays[i].bounds, view)) expected++;
+        cout << "# " << countVisible(&scene->indirectBatches) << " of " << scene->arrays.size()
+             << " arrays drawn after the GPU cull, " << expected << " overlap the view" << endl;
+    }
+
+    // Streamed runs report the per-frame upload rate instead
+    if (streamArrays){
+        uploadMs = streamMs / frames;
+        deleteStream(&stream);
+        for (size_t i = 0; i < scene->arrays.size(); i++)
+            scene->arrays[i].vertexBuffer = 0;
+        arenaReset(&benchArena);
+    }
+
+    benchResult result;
+    result.kind = kind;
+    result.primitives = primitives;
+    result.drawCalls = (atlasing ? scene->textureBatches.size() : scene->polygons.size()) +
+        scene->meshes.size() + scene->instanced.size() +
+        (batching ? scene->batches.size() : indirect ? scene->indirectBatches.size() : scene->arrays.size());
+    if (scene->recording)
+        result.drawCalls = scene->drawn / frames + scene->instanced.size() + scene->indirectBatches.size() +
+            (batching ? scene->batches.size() : 0) + (atlasing ? scene->textureBatches.size() : 0);
+    if (scene->lod) result.drawCalls = scene->drawn / frames;
+    result.cullMs = scene->cullMs / frames;
+    result.fps = frames / (totalMs / 1000.0);
+    result.p50 = percentile(frameMs, 0.50);
+    result.p95 = percentile(frameMs, 0.95);
+    result.p99 = percentile(frameMs, 0.99);
+    result.uploadMBps = (scene->uploadBytes / (1024.0 * 1024.0)) / max(uploadMs / 1000.0, 1e-9);
+
+    stateStats const& stats = stateStatistics();
+    result.stateCalls = result.redundantCalls = 0.0;
+    for (int k = 0; k < STATE_KINDS; k++){
+        result.stateCalls += stats.issued[k];
+        result.redundantCalls += stats.skipped[k];
+    }
+    result.stateCalls /= frames;
+    result.redundantCalls /= frames;
+
+    deleteBatches(&scene->batches);
+    deleteBatches(&scene->indirectBatches);
+    deleteBatches(&scene->textureBatches);
+    deleteCullGrid(&scene->grid);
+    deleteObjectBuffer(&scene->objects);
+    scene->movedBounds.clear();
+    stateDeleteBuffers(1, &scene->cloud.vertexBuffer);
+    stateDeleteVertexArrays(1, &scene->cloud.vertexArrayID);
+    MVP = sceneMVP;
+    for (size_t i = 0; i < scene->arrays.size(); i++)
+        deleteArray(&scene->arrays[i]);
+    for (size_t i = 0; i < scene->polygons.size(); i++){
+        stateDeleteBuffers(1, &scene->polygons[i].vertexBuffer);
+        stateDeleteBuffers(1, &scene->polygons[i].uvBuffer);
+        stateDeleteVertexArrays(1, &scene->polygons[i].vertexArrayID);
+    }
+    for (size_t i = 0; i < scene->meshes.size(); i++)
+        deleteArray(&scene->meshes[i]);
+    for (size_t i = 0; i < scene->instanced.size(); i++){
+        stateDeleteBuffers(1, &scene->instanced[i].vertexBuffer);
+        stateDeleteBuffers(1, &scene->instanced[i].uvBuffer);
+        stateDeleteBuffers(1, &scene->instanced[i].instanceBuffer);
+        stateDeleteVertexArrays(1, &scene->instanced[i].vertexArrayID);
+    }
+    delete scene;
+
+    return result;
+}
+
+int main(int argc, char *argv[]){
+    // Headless unless another backend is asked for
+    context.backend = BACKEND_EGL;
+    context.frames = 100;
+    parseContextOptions(argc, argv);
+    parseProgramCacheOptions(argc, argv);
+    parseTextureCacheOptions(argc, argv);
+    parseResolutionOptions(argc, argv);
+
+    long maxPrimitives = 1000000;
+    string csvPath = "";
+    for (int i = 1; i < argc; i++){
+        string arg = argv[i];
+        if (arg == "--batch") batching = true;
+        else if (arg == "--instanced") instancing = true;
+        else if (arg == "--stream") streaming = true;
+        else if (arg == "--no-state-cache") stateCacheEnabled = false;
+        else if (arg == "--atlas") atlasing = true;
+        else if (arg == "--indexed") indexing = true;
+        else if (arg == "--compact") compacting = true;
+        else if (arg == "--cull") culling = true;
+        else if (arg == "--gpu-cull") culling = gpuCulling = true;
+        else if (arg == "--jobs" && i + 1 < argc) jobThreads = max(0, atoi(argv[++i]));
+        else if (arg == "--lod" && i + 1 < argc) lodBudget = max(0L, atol(argv[++i]));
+        else if (arg == "--objects") movingObjects = true;
+        else if (arg == "--pool") pooling = true;
+        else if (arg.compare(0, 9, "--stream=") == 0){
+            streaming = true;
+            benchStreamMode = parseStreamMode(arg.substr(9).c_str());
+        }
+        else if (arg == "--max" && i + 1 < argc) maxPrimitives = atol(argv[++i]);
+        else if (arg == "--per-object" && i + 1 < argc) primitivesPerObject = max(1L, atol(argv[++i]));
+        else if (arg == "--csv" && i + 1 < argc) csvPath = argv[++i];
+    }
+
+    // cullObjects.comp tests the bounds the arrays were uploaded with
+    if (gpuCulling && movingObjects){
+        cerr << "Fatal: --gpu-cull does not cull arrays moved by --objects, use --cull" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    init();
+    sceneMVP = MVP;
+    if (jobThreads >= 0) startJobSystem(jobThreads);
+
+    string vs = "", fs = "", vs2 = "", fs2 = "";
+    assert(fileRead("colorVertex.vert", &vs) >= 0);
+    assert(fileRead("colorFragment.frag", &fs) >= 0);
+    assert(fileRead("textureVertex.vert", &vs2) >= 0);
+    assert(fileRead("textureFragment.frag", &fs2) >= 0);
+    string vs3 = "", vs4 = "", vs5 = "", fs5 = "";
+    assert(fileRead("colorInstanced.vert", &vs3) >= 0);
+    assert(fileRead("textureInstanced.vert", &vs4) >= 0);
+    assert(fileRead("textureArray.vert", &vs5) >= 0);
+    assert(fileRead("textureArray.frag", &fs5) >= 0);
+    string vs6 = "", vs7 = "";
+    assert(fileRead("pointLOD.vert", &vs6) >= 0);
+    assert(fileRead("colorObject.vert", &vs7) >= 0);
+
+    // Compiled in the background while the texture loads
+    benchClock::time_point start = benchClock::now();
+    colorShader = compileShaderAsync(vs, fs);
+    textureShader = compileShaderAsync(vs2, fs2);
+    colorInstancedShader = compileShaderAsync(vs3, fs);
+    textureInstancedShader = compileShaderAsync(vs4, fs2);
+    textureArrayShader = compileShaderAsync(vs5, fs5);
+    pointLODShader = compileShaderAsync(vs6, fs);
+    colorObjectShader = compileShaderAsync(vs7, fs);
+    texture = loadTexture("test.png");
+    if (atlasing){
+        for (int i = 0; i < ATLAS_IMAGES; i++) atlasAdd(&benchAtlas, "test.png");
+        buildAtlas(&benchAtlas, 2048);
+    }
+    finishTextures();
+    finishPrograms();
+    double startupMs = elapsedMs(start);
+
+    // Falls back to the per-object draws of --cull
+    if (gpuCulling && !gpuCullSupported()){
+        cout << "# No GL 4.3 compute shaders, --gpu-cull culls on the CPU" << endl;
+        gpuCulling = false;
+    }
+
+    cout << "# " << glGetString(GL_RENDERER) << ", " << context.frames
+         << " frames per case, " << primitivesPerObject << " primitives per object"
+         << (batching ? ", batched" : "") << (instancing ? ", instanced" : "")
+         << (streaming ? ", streamed" : "") << (atlasing ? ", atlas" : "")
+         << (indexing ? ", indexed" : "") << (compacting ? ", compact" : "")
+         << (gpuCulling ? ", GPU culled" : culling ? ", culled" : "")
+         << (lodBudget ? ", " + to_string(lodBudget) + " point budget" : "")
+         << (movingObjects ? ", moving objects" : "")
+         << (pooling ? ", pooled buffers" : "")
+         << (resolutionEnabled() ? ", dynamic resolution" : "")
+         << (jobThreads >= 0 ? ", " + to_string(jobThreadCount()) + " threads recording" : "")
+         << (stateCacheEnabled ? "" : ", no state cache") << endl;
+    cout << "# Shaders and texture ready in " << fixed << setprecision(2) << startupMs
+         << " ms" << endl;
+    if (indexing) benchMesh();
+    if (pooling) benchPool();
+
+    cout << left << setw(10) << "kind" << right << setw(10) << "prims"
+         << setw(10) << "draws" << setw(10) << "fps" << setw(10) << "p50 ms"
+         << setw(10) << "p95 ms" << setw(10) << "p99 ms" << setw(12) << "upload MB/s"
+         << setw(10) << "state/f" << setw(10) << "redund/f" << setw(10) << "cull ms" << endl;
+
+    vector<benchResult> results;
+    for (int kind = BENCH_POINTS; kind <= BENCH_QUADS; kind++){
+        for (long primitives = 100; primitives <= maxPrimitives; primitives *= 10){
+            benchResult r = runCase((benchKind)kind, primitives, context.frames);
+            results.push_back(r);
+            cout << fixed << setprecision(2) << left << setw(10) << kindNames[r.kind]
+                 << right << setw(10) << r.primitives << setw(10) << r.drawCalls
+                 << setw(10) << r.fps << setw(10) << r.p50 << setw(10) << r.p95
+                 << setw(10) << r.p99 << setw(12) << r.uploadMBps
+                 << setw(10) << r.stateCalls << setw(10) << r.redundantCalls
+                 << setw(10) << setprecision(3) << r.cullMs << endl;
+            if (resolutionEnabled()) cout << "# render scale " << setprecision(2) << renderScale << endl;
+        }
+    }
+
+    if (!csvPath.empty()){
+        ofstream csv(csvPath.c_str());
+        csv << "kind,primitives,draw_calls,fps,p50_ms,p95_ms,p99_ms,upload_mb_per_s,"
+               "state_calls_per_frame,redundant_calls_per_frame,cull_ms_per_frame\n";
+        for (size_t i = 0; i < results.size(); i++){
+            benchResult const& r = results[i];
+            csv << kindNames[r.kind] << "," << r.primitives << "," << r.drawCalls << ","
+                << r.fps << "," << r.p50 << "," << r.p95 << "," << r.p99 << ","
+                << r.uploadMBps << "," << r.stateCalls << "," << r.redundantCalls << ","
+                << r.cullMs << "\n";
+        }
+    }
+
+    arenaRelease(&benchArena);
+    stopTextureLoader();
+    stopJobSystem();
+    stateDeleteTextures(1, &texture);
+    releaseProgram(colorShader);
+    releaseProgram(textureShader);
+    releaseProgram(colorInstancedShader);
+    releaseProgram(textureInstancedShader);
+    releaseProgram(textureArrayShader);
+    releaseProgram(pointLODShader);
+    releaseProgram(colorObjectShader);
+    deleteAtlas(&benchAtlas);
+    stateDeleteVertexArrays(1, &VertexArrayID);
+    finishGPUCull();
+    releasePool();
+    deleteFrameUniforms();
+    finishResolution();
+    stateObjects const& live = stateObjectStatistics();
+    if (live.buffers || live.textures) printLiveObjects(cerr);
+    destroyContext();
+
+    return 0;
+}
@@ -0,0 +1,205 @@
+#include <GL/glew.h>
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <assert.h>
+
+#include "BufferPool.h"
+#include "State.h"
+
+using namespace std;
+
+struct poolAllocation {
+    GLsizeiptr size; // Aligned
+    GLuint *buffer;  // The owner's, rewritten on a move
+    GLintptr *offset;
+    poolMovedFunction moved;
+    void *owner;
+};
+
+struct poolBlock {
+    GLuint buffer;
+    GLsizeiptr size;
+    map<GLintptr, GLsizeiptr> free; // Offset to size, never two adjacent
+    map<GLintptr, poolAllocation> used;
+};
+
+static vector<poolBlock> blocks;
+static poolStats stats;
+
+static GLsizeiptr alignSize(GLsizeiptr size){
+    return (max(size, (GLsizeiptr)1) + POOL_ALIGNMENT - 1) / POOL_ALIGNMENT * POOL_ALIGNMENT;
+}
+
+static poolBlock* findBlock(GLuint buffer){
+    for (size_t i = 0; i < blocks.size(); i++)
+        if (blocks[i].buffer == buffer) return &blocks[i];
+    return NULL;
+}
+
+static poolBlock newBlock(GLsizeiptr size){
+    poolBlock block;
+    block.size = size;
+    stateGenBuffers(1, &block.buffer, "buffer pool");
+    stateBindBuffer(GL_COPY_WRITE_BUFFER, block.buffer);
+    stateBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STATIC_DRAW);
+    return block;
+}
+
+// Takes size bytes from the first free range that holds them
+static bool takeRange(poolBlock *block, GLsizeiptr size, GLintptr *offset){
+    for (map<GLintptr, GLsizeiptr>::iterator it = block->free.begin(); it != block->free.end(); ++it){
+        if (it->second < size) continue;
+        *offset = it->first;
+        GLsizeiptr rest = it->second - size;
+        block->free.erase(it);
+        if (rest > 0) block->free[*offset + size] = rest;
+        return true;
+    }
+    return false;
+}
+
+void poolAllocate(GLsizeiptr size, GLuint *buffer, GLintptr *offset, poolMovedFunction moved, void *owner){
+    size = alignSize(size);
+    poolBlock *block = NULL;
+    GLintptr at = 0;
+    for (size_t i = 0; i < blocks.size() && !block; i++)
+        if (takeRange(&blocks[i], size, &at)) block = &blocks[i];
+
+    if (!block){
+        blocks.push_back(newBlock(max(size, POOL_BLOCK_SIZE)));
+        block = &blocks.back();
+        if (block->size > size) block->free[size] = block->size - size;
+        at = 0;
+    }
+
+    poolAllocation allocation = {size, buffer, offset, moved, owner};
+    block->used[at] = allocation;
+    *buffer = block->buffer;
+    *offset = at;
+}
+
+void poolWrite(GLuint buffer, GLintptr offset, GLsizeiptr size, const void *data){
+    // The copy target, so no VAO's element array binding is touched
+    stateBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+}
+
+void poolFree(GLuint buffer, GLintptr offset){
+    poolBlock *block = findBlock(buffer);
+    assert(block && block->used.count(offset) && "poolFree of a range the pool did not hand out");
+    GLsizeiptr size = block->used[offset].size;
+    block->used.erase(offset);
+
+    // Merged with the free ranges on either side
+    map<GLintptr, GLsizeiptr>::iterator next = block->free.lower_bound(offset);
+    if (next != block->free.end() && next->first == offset + size){
+        size += next->second;
+        next = block->free.erase(next);
+    }
+    if (next != block->free.begin()){
+        map<GLintptr, GLsizeiptr>::iterator previous = prev(next);
+        if (previous->first + previous->second == offset){
+            previous->second += size;
+            return;
+        }
+    }
+    block->free[offset] = size;
+}
+
+bool poolOwns(GLuint buffer){
+    return buffer != 0 && findBlock(buffer) != NULL;
+}
+
+// Whether any block has a hole before its end, or nothing in it at all
+static bool fragmented(){
+    for (size_t i = 0; i < blocks.size(); i++){
+        poolBlock const& block = blocks[i];
+        if (block.used.empty()) return true;
+        if (block.free.size() > 1) return true;
+        if (block.free.size() == 1 && block.free.begin()->first + block.free.begin()->second != block.size)
+            return true;
+    }
+    return false;
+}
+
+size_t defragmentPool(){
+    if (!fragmented()) return 0;
+
+    // Live ranges go into new blocks in their old order, which keeps the
+    // data of objects created together close
+    vector<poolBlock> packed;
+    GLintptr end = 0; // Of the data in packed.back()
+    size_t moved = 0;
+    for (size_t b = 0; b < blocks.size(); b++){
+        stateBindBuffer(GL_COPY_READ_BUFFER, blocks[b].buffer);
+        for (map<GLintptr, poolAllocation>::iterator it = blocks[b].used.begin(); it != blocks[b].used.end(); ++it){
+            poolAllocation const& allocation = it->second;
+            if (packed.empty() || end + allocation.size > packed.back().size){
+                packed.push_back(newBlock(max(allocation.size, POOL_BLOCK_SIZE)));
+                end = 0;
+            }
+            poolBlock &block = packed.back();
+            stateBindBuffer(GL_COPY_WRITE_BUFFER, block.buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, it->first, end, allocation.size);
+            block.used[end] = allocation;
+            *allocation.buffer = block.buffer;
+            *allocation.offset = end;
+            end += allocation.size;
+            moved += allocation.size;
+        }
+    }
+    if (!packed.empty() && end < packed.back().size) packed.back().free[end] = packed.back().size - end;
+
+    // GL keeps the old buffers alive until the copies out of them are done
+    for (size_t b = 0; b < blocks.size(); b++) stateDeleteBuffers(1, &blocks[b].buffer);
+    blocks.swap(packed);
+
+    for (size_t b = 0; b < blocks.size(); b++)
+        for (map<GLintptr, poolAllocation>::iterator it = blocks[b].used.begin(); it != blocks[b].used.end(); ++it)
+            if (it->second.moved) it->second.moved(it->second.owner);
+
+    stats.bytesMoved += moved;
+    return moved;
+}
+
+poolStats const& poolStatistics(){
+    size_t bytesMoved = stats.bytesMoved;
+    stats = poolStats();
+    stats.bytesMoved = bytesMoved;
+    stats.blocks = blocks.size();
+    for (size_t b = 0; b < blocks.size(); b++){
+        poolBlock const& block = blocks[b];
+        stats.reservedBytes += block.size;
+        stats.allocations += block.used.size();
+        for (map<GLintptr, poolAllocation>::const_iterator it = block.used.begin(); it != block.used.end(); ++it)
+            stats.usedBytes += it->second.size;
+        stats.freeRanges += block.free.size();
+        for (map<GLintptr, GLsizeiptr>::const_iterator it = block.free.begin(); it != block.free.end(); ++it)
+            stats.largestFree = max(stats.largestFree, (size_t)it->second);
+    }
+    return stats;
+}
+
+void printPoolStatistics(ostream &out){
+    poolStats const& pool = poolStatistics();
+    out << "Buffer pool: " << pool.allocations << " ranges of " << pool.usedBytes << " bytes in "
+        << pool.blocks << " blocks of " << pool.reservedBytes << " bytes";
+    if (pool.reservedBytes)
+        out << " (" << fixed << setprecision(1) << 100.0 * pool.usedBytes / pool.reservedBytes << "% used)";
+    out << ", " << pool.freeRanges << " free ranges, largest " << pool.largestFree
+        << ", " << pool.bytesMoved << " bytes moved" << endl;
+}
+
+void releasePool(){
+    unsigned long leaked = 0;
+    for (size_t b = 0; b < blocks.size(); b++){
+        leaked += blocks[b].used.size();
+        stateDeleteBuffers(1, &blocks[b].buffer);
+    }
+    if (leaked) cerr << "Buffer pool released with " << leaked << " ranges still allocated" << endl;
+    blocks.clear();
+}
@@ -0,0 +1,57 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <GL/glew.h>
+
+#include <iostream>
+
+// Static vertex and index data sub-allocated from a few large buffers,
+// instead of a buffer per object. Ranges are handed out first-fit from each
+// block's free list, and freed ranges merge with their neighbours. Objects
+// then share buffers, so creating many of them costs no buffer objects, and
+// their VAOs point into a block at an offset.
+//
+// A pool that has seen many frees can be packed with defragmentPool, which
+// copies the live ranges on the GPU and tells each owner where its data went.
+
+static const GLsizeiptr POOL_BLOCK_SIZE = 4 << 20; // Bytes per block, larger ranges get a block of their own
+static const GLsizeiptr POOL_ALIGNMENT = 16;       // Of every range, enough for any attribute or index type
+
+// Called after defragmentPool has moved one of owner's ranges, e.g. to point
+// its VAO at the new buffer and offset
+typedef void (*poolMovedFunction)(void *owner);
+
+struct poolStats {
+    unsigned long blocks;
+    size_t reservedBytes; // In all blocks
+    size_t usedBytes;     // By live ranges, alignment included
+    unsigned long allocations;
+    unsigned long freeRanges;
+    size_t largestFree;
+    size_t bytesMoved; // By every defragmentPool so far
+};
+
+// Reserves size bytes and stores where in *buffer and *offset. Both are
+// rewritten when defragmentPool moves the range, so they must stay at the
+// same address until poolFree; moved may be NULL.
+void poolAllocate(GLsizeiptr size, GLuint *buffer, GLintptr *offset, poolMovedFunction moved, void *owner);
+
+// Copies size bytes into an allocated range
+void poolWrite(GLuint buffer, GLintptr offset, GLsizeiptr size, const void *data);
+
+void poolFree(GLuint buffer, GLintptr offset);
+
+// Whether buffer is one of the pool's blocks, rather than an object's own
+bool poolOwns(GLuint buffer);
+
+// Packs the live ranges into as few blocks as they fit and releases the
+// rest. Returns the bytes copied, 0 if the pool had no holes.
+size_t defragmentPool();
+
+poolStats const& poolStatistics();
+void printPoolStatistics(std::ostream &out);
+
+// Deletes every block. Ranges still allocated are reported on cerr.
+void releasePool();
+
+#endif
@@ -0,0 +1,306 @@
+#ifdef WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#endif
+
+#include <GL/glew.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <png.h>
+
+#include "Capture.h"
+#include "Context.h"
+#include "Render.h"
+#include "State.h"
+
+using namespace std;
+
+captureOptions capture = {"", 3, 0, 60};
+
+// Frames are read back as 8-bit RGBA, the format drivers copy fastest
+static const int CAPTURE_CHANNELS = 4;
+
+struct captureSlot {
+    GLuint buffer;
+    GLsync fence; // Signals once the read into buffer is done
+    int frame;
+};
+
+struct captureJob {
+    int frame;
+    vector<GLubyte> pixels; // RGBA rows, bottom row first
+};
+
+static vector<captureSlot> ring;
+static size_t oldest = 0;   // Slot of the oldest read in flight
+static size_t inFlight = 0;
+static int framesCaptured = 0;
+static GLint captureWidth = 0;
+static GLint captureHeight = 0;
+static bool y4m = false;
+static FILE *stream = NULL; // The Y4M file
+
+// The mutex guards the queue, stopping and nextWrite
+static mutex captureMutex;
+static condition_variable workQueued;   // Wakes the encoders
+static condition_variable workTaken;    // Wakes the GL thread waiting for room
+static condition_variable frameWritten; // Wakes Y4M encoders waiting their turn
+static deque<captureJob*> queue;
+static vector<thread> encoders;
+static bool stopping = false;
+static int nextWrite = 0; // Y4M frames are appended in order
+
+static bool endsWith(string const& text, string const& suffix){
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+void parseCaptureOptions(int argc, char *argv[]){
+    for (int i = 1; i < argc; i++){
+        string arg = argv[i];
+        if (arg == "--capture" && i + 1 < argc) capture.pattern = argv[++i];
+        else if (arg == "--capture-ring" && i + 1 < argc) capture.ring = atoi(argv[++i]);
+        else if (arg == "--capture-threads" && i + 1 < argc) capture.threads = max(0, atoi(argv[++i]));
+        else if (arg == "--capture-fps" && i + 1 < argc) capture.rate = atoi(argv[++i]);
+    }
+
+    if (capture.pattern.empty()) return;
+    if (!endsWith(capture.pattern, ".png") && !endsWith(capture.pattern, ".y4m")){
+        cerr << "Fatal: --capture needs a .png pattern or a .y4m file" << endl;
+        exit(EXIT_FAILURE);
+    }
+    // PNG names go through snprintf on the encoder threads, the Y4M file is
+    // opened by name
+    if (endsWith(capture.pattern, ".png") && !validFramePattern(capture.pattern)){
+        cerr << "Fatal: --capture takes at most one %d or %0Nd, write % itself as %%" << endl;
+        exit(EXIT_FAILURE);
+    }
+    if (capture.ring < 2 || capture.rate <= 0){
+        cerr << "Fatal: --capture-ring needs at least 2 buffers and --capture-fps a positive rate" << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Writes top-down rows at the fastest compression, encoding time is what
+// limits the capture rate. libpng reports errors by longjmp, so nothing in
+// here may need destructing.
+static void encodePNG(captureJob *job){
+    char fileName[1024];
+    snprintf(fileName, sizeof(fileName), capture.pattern.c_str(), job->frame);
+    FILE *fp = fopen(fileName, "wb");
+    if (!fp){
+        cerr << "Could not open " << fileName << " for writing" << endl;
+        return;
+    }
+
+    png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info_ptr = png_ptr ? png_create_info_struct(png_ptr) : NULL;
+    png_bytep *volatile row_pointers = NULL;
+    if (!info_ptr || setjmp(png_jmpbuf(png_ptr))){
+        cerr << "Could not write " << fileName << endl;
+        png_destroy_write_struct(&png_ptr, info_ptr ? &info_ptr : NULL);
+        free(row_pointers);
+        fclose(fp);
+        return;
+    }
+
+    png_init_io(png_ptr, fp);
+    png_set_compression_level(png_ptr, 1);
+    png_set_filter(png_ptr, 0, PNG_FILTER_SUB);
+    png_set_IHDR(png_ptr, info_ptr, captureWidth, captureHeight, 8, PNG_COLOR_TYPE_RGB_ALPHA,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png_ptr, info_ptr);
+
+    row_pointers = (png_bytep*)malloc(captureHeight * sizeof(png_bytep));
+    if (row_pointers){
+        for (GLint y = 0; y < captureHeight; y++)
+            row_pointers[y] = job->pixels.data() + (size_t)(captureHeight - 1 - y) * captureWidth * CAPTURE_CHANNELS;
+        png_write_image(png_ptr, row_pointers);
+        png_write_end(png_ptr, NULL);
+    }
+
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    free(row_pointers);
+    fclose(fp);
+}
+
+// Converts to full range BT.601 4:2:0, as C420jpeg declares, then appends
+// the frame once every earlier one has been written
+static void encodeY4M(captureJob *job){
+    GLint w = captureWidth, h = captureHeight;
+    GLint cw = (w + 1) / 2, ch = (h + 1) / 2;
+    vector<GLubyte> planes((size_t)w * h + (size_t)cw * ch * 2);
+    GLubyte *luma = planes.data(), *cb = luma + (size_t)w * h, *cr = cb + (size_t)cw * ch;
+
+    for (GLint y = 0; y < h; y++){
+        const GLubyte *row = job->pixels.data() + (size_t)(h - 1 - y) * w * CAPTURE_CHANNELS;
+        for (GLint x = 0; x < w; x++){
+            const GLubyte *p = row + x * CAPTURE_CHANNELS;
+            luma[(size_t)y * w + x] = (GLubyte)((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+        }
+    }
+    for (GLint y = 0; y < ch; y++){
+        for (GLint x = 0; x < cw; x++){
+            int r = 0, g = 0, b = 0, n = 0;
+            for (GLint dy = 0; dy < 2 && y * 2 + dy < h; dy++){
+                for (GLint dx = 0; dx < 2 && x * 2 + dx < w; dx++){
+                    const GLubyte *p = job->pixels.data() +
+                        ((size_t)(h - 1 - (y * 2 + dy)) * w + x * 2 + dx) * CAPTURE_CHANNELS;
+                    r += p[0];
+                    g += p[1];
+                    b += p[2];
+                    n++;
+                }
+            }
+            r /= n;
+            g /= n;
+            b /= n;
+            cb[(size_t)y * cw + x] = (GLubyte)min(255, max(0, 128 + ((-43 * r - 85 * g + 128 * b + 128) >> 8)));
+            cr[(size_t)y * cw + x] = (GLubyte)min(255, max(0, 128 + ((128 * r - 107 * g - 21 * b + 128) >> 8)));
+        }
+    }
+
+    // Only one encoder can hold the next frame, so it writes unlocked
+    unique_lock<mutex> lock(captureMutex);
+    frameWritten.wait(lock, [job]{ return nextWrite == job->frame; });
+    lock.unlock();
+    fputs("FRAME\n", stream);
+    fwrite(planes.data(), 1, planes.size(), stream);
+    lock.lock();
+    nextWrite++;
+    frameWritten.notify_all();
+}
+
+static void encoderLoop(){
+    unique_lock<mutex> lock(captureMutex);
+    while (true){
+        workQueued.wait(lock, []{ return stopping || !queue.empty(); });
+        if (queue.empty()) return; // Stopping, and every frame is taken
+
+        captureJob *job = queue.front();
+        queue.pop_front();
+        workTaken.notify_one();
+
+        lock.unlock();
+        if (y4m) encodeY4M(job);
+        else encodePNG(job);
+        delete job;
+        lock.lock();
+    }
+}
+
+static void startCapture(){
+    captureWidth = width;
+    captureHeight = height;
+    y4m = endsWith(capture.pattern, ".y4m");
+    if (y4m){
+        stream = fopen(capture.pattern.c_str(), "wb");
+        if (!stream){
+            cerr << "Fatal: Could not open " << capture.pattern << " for writing" << endl;
+            exit(EXIT_FAILURE);
+        }
+        fprintf(stream, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", captureWidth, captureHeight, capture.rate);
+    }
+
+    ring.resize(capture.ring);
+    for (size_t i = 0; i < ring.size(); i++){
+        stateGenBuffers(1, &ring[i].buffer, "capture ring");
+        stateBindBuffer(GL_PIXEL_PACK_BUFFER, ring[i].buffer);
+        stateBufferData(GL_PIXEL_PACK_BUFFER, (size_t)captureWidth * captureHeight * CAPTURE_CHANNELS,
+                     NULL, GL_STREAM_READ);
+        ring[i].fence = 0;
+    }
+    stateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    int threads = capture.threads;
+    if (threads <= 0){
+        unsigned int hardware = thread::hardware_concurrency();
+        threads = hardware > 1 ? hardware - 1 : 1; // Leaves a core to the GL thread
+    }
+    stopping = false;
+    for (int i = 0; i < threads; i++) encoders.push_back(thread(encoderLoop));
+}
+
+// Hands the oldest read to the encoders once its fence has signalled, or
+// waits for it with wait set. Returns false if nothing was handed on.
+static bool collectOldest(bool wait){
+    if (inFlight == 0) return false;
+    captureSlot &slot = ring[oldest];
+    GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? GL_TIMEOUT_IGNORED : 0);
+    if (status == GL_TIMEOUT_EXPIRED) return false;
+    glDeleteSync(slot.fence);
+    slot.fence = 0;
+
+    size_t bytes = (size_t)captureWidth * captureHeight * CAPTURE_CHANNELS;
+    captureJob *job = new captureJob();
+    job->frame = slot.frame;
+    job->pixels.resize(bytes);
+    stateBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    void *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+    if (mapped){
+        memcpy(job->pixels.data(), mapped, bytes);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    } else {
+        cerr << "Could not map captured frame " << slot.frame << endl;
+    }
+    stateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    oldest = (oldest + 1) % ring.size();
+    inFlight--;
+
+    // Encoders that fall behind hold the render loop back, rather than
+    // letting frames pile up without bound
+    unique_lock<mutex> lock(captureMutex);
+    workTaken.wait(lock, []{ return queue.size() < (size_t)CAPTURE_MAX_QUEUED; });
+    queue.push_back(job);
+    workQueued.notify_one();
+    return true;
+}
+
+void captureFrame(){
+    if (capture.pattern.empty()) return;
+    if (ring.empty()) startCapture();
+
+    // Hand on the reads that are done, then make room for this one
+    while (collectOldest(false));
+    if (inFlight == ring.size()) collectOldest(true);
+
+    captureSlot &slot = ring[(oldest + inFlight) % ring.size()];
+    stateBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glReadPixels(0, 0, captureWidth, captureHeight, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = framesCaptured++;
+    inFlight++;
+
+    // Reads into client memory, such as the --output frames, need it unbound
+    stateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void finishCapture(){
+    if (ring.empty()) return;
+    while (collectOldest(true));
+
+    unique_lock<mutex> lock(captureMutex);
+    stopping = true;
+    lock.unlock();
+    workQueued.notify_all();
+    for (size_t i = 0; i < encoders.size(); i++) encoders[i].join();
+    encoders.clear();
+
+    for (size_t i = 0; i < ring.size(); i++) stateDeleteBuffers(1, &ring[i].buffer);
+    ring.clear();
+    oldest = inFlight = 0;
+    if (stream){
+        fclose(stream);
+        stream = NULL;
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <GL/glew.h>
+
+#include <string>
+
+// Frame capture that does not stall the pipeline. Each frame is read into
+// the next pixel pack buffer of a ring and fenced, and only mapped once the
+// fence has signalled, normally a frame or two later. The pixels are then
+// copied out and handed to encoder threads, which write one PNG per frame or
+// append to a Y4M stream. Every call here is made on the GL thread.
+
+static const int CAPTURE_MAX_QUEUED = 8; // Frames waiting for an encoder before captureFrame blocks
+
+struct captureOptions {
+    std::string pattern; // printf pattern ending in .png, or a .y4m file; "" captures nothing
+    int ring;            // Pixel pack buffers in flight
+    int threads;         // Encoder threads, 0 picks one less than the hardware threads
+    int rate;            // Frames per second written into Y4M headers
+};
+
+extern captureOptions capture;
+
+// Parses --capture PATTERN, --capture-ring N, --capture-threads N and
+// --capture-fps N
+void parseCaptureOptions(int argc, char *argv[]);
+
+// Reads back the frame about to be presented. Call just before
+// contextSwapBuffers. Does nothing without --capture.
+void captureFrame();
+
+// Collects the frames still in flight, waits for the encoders and closes
+// the output. Call before destroying the context.
+void finishCapture();
+
+#endif
@@ -0,0 +1,312 @@
+#ifdef WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+    #include <GL/glew.h>
+    #include <OpenGL/gl.h>
+#else
+    #include <GL/glew.h>
+    #include <GL/gl.h>
+#endif
+
+#ifdef USE_EGL
+    #include <EGL/egl.h>
+    #include <EGL/eglext.h>
+#endif
+
+#ifdef USE_OSMESA
+    #include <GL/osmesa.h>
+#endif
+
+#include <GLFW/glfw3.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <assert.h>
+
+#include "Context.h"
+
+using namespace std;
+
+GLFWwindow* window = NULL;
+contextOptions context = {BACKEND_WINDOW, 0, ""};
+GLuint frameBufferID = 0;
+
+static GLuint colorBufferID = 0;
+static GLuint depthBufferID = 0;
+static GLint frameWidth = 0;
+static GLint frameHeight = 0;
+static int framesRendered = 0;
+static vector<unsigned char> framePixels;
+
+#ifdef USE_EGL
+static EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+static EGLContext eglContext = EGL_NO_CONTEXT;
+#endif
+
+#ifdef USE_OSMESA
+static OSMesaContext osmesaContext = NULL;
+static vector<unsigned char> osmesaBuffer; // OSMesa needs a bound buffer, even though we draw to the FBO
+#endif
+
+static void keyboardCallback(GLFWwindow* window, int key, int scancode,
+                             int action, int mods){
+    if(key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, GL_TRUE);
+}
+
+static contextBackend parseBackend(string const& name){
+    if (name == "" || name == "egl") return BACKEND_EGL;
+    if (name == "osmesa") return BACKEND_OSMESA;
+    cerr << "Fatal: Unknown headless backend " << name << endl;
+    exit(EXIT_FAILURE);
+}
+
+bool validFramePattern(string const& pattern){
+    int conversions = 0;
+    for (size_t i = 0; i < pattern.size(); i++){
+        if (pattern[i] != '%') continue;
+        if (++i < pattern.size() && pattern[i] == '%') continue;
+        while (i < pattern.size() && isdigit((unsigned char)pattern[i])) i++;
+        if (i >= pattern.size() || pattern[i] != 'd' || ++conversions > 1) return false;
+    }
+    return true;
+}
+
+void parseContextOptions(int argc, char *argv[]){
+    bool hasOutput = false;
+    for (int i = 1; i < argc; i++){
+        string arg = argv[i];
+        if (arg == "--headless"){
+            context.backend = parseBackend("");
+        } else if (arg.compare(0, 11, "--headless=") == 0){
+            context.backend = parseBackend(arg.substr(11));
+        } else if (arg == "--frames" && i + 1 < argc){
+            context.frames = atoi(argv[++i]);
+        } else if (arg == "--output" && i + 1 < argc){
+            context.output = argv[++i];
+            if (context.output == "none") context.output = "";
+            hasOutput = true;
+        }
+    }
+
+    // A headless run with no frame limit would never finish
+    if (context.backend != BACKEND_WINDOW && context.frames <= 0)
+        context.frames = 1;
+    if (context.backend != BACKEND_WINDOW && !hasOutput)
+        context.output = "frame%04d.ppm";
+    if (!validFramePattern(context.output)){
+        cerr << "Fatal: --output takes at most one %d or %0Nd, write % itself as %%" << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void createWindowContext(GLint width, GLint height){
+    assert(glfwInit() == true  && "Could not initialize GLFW");
+
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+
+    window = glfwCreateWindow(width, height,"title", NULL, NULL);
+    assert(window != NULL && "Could not initialize window");
+    glfwMakeContextCurrent(window);
+
+    glfwSetKeyCallback(window, keyboardCallback); // Set GLFW call back function
+}
+
+static void createEGLContext(){
+#ifdef USE_EGL
+    // Prefer the surfaceless platform, so no display server or GPU is needed
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay)
+        eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (eglDisplay == EGL_NO_DISPLAY)
+        eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    assert(eglDisplay != EGL_NO_DISPLAY && "Could not get an EGL display");
+
+    EGLint major, minor;
+    if (!eglInitialize(eglDisplay, &major, &minor)){
+        cerr << "Fatal: Could not initialize EGL" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config = (EGLConfig)0;
+    EGLint numConfigs = 0;
+    eglChooseConfig(eglDisplay, configAttribs, &config, 1, &numConfigs);
+
+    eglBindAPI(EGL_OPENGL_API);
+    EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    eglContext = eglCreateContext(eglDisplay, numConfigs > 0 ? config : (EGLConfig)0,
+                                  EGL_NO_CONTEXT, contextAttribs);
+    if (eglContext == EGL_NO_CONTEXT){
+        cerr << "Fatal: Could not create EGL context" << endl;
+        exit(EXIT_FAILURE);
+    }
+    eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext);
+#else
+    cerr << "Fatal: Built without EGL support (-DUSE_EGL)" << endl;
+    exit(EXIT_FAILURE);
+#endif
+}
+
+static void createOSMesaContext(GLint width, GLint height){
+#ifdef USE_OSMESA
+    const int attribs[] = {
+        OSMESA_FORMAT, OSMESA_RGBA,
+        OSMESA_DEPTH_BITS, 24,
+        OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+        OSMESA_CONTEXT_MAJOR_VERSION, 3,
+        OSMESA_CONTEXT_MINOR_VERSION, 3,
+        0
+    };
+    osmesaContext = OSMesaCreateContextAttribs(attribs, NULL);
+    if (osmesaContext == NULL){
+        cerr << "Fatal: Could not create OSMesa context" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    osmesaBuffer.resize(width * height * 4);
+    OSMesaMakeCurrent(osmesaContext, osmesaBuffer.data(), GL_UNSIGNED_BYTE, width, height);
+#else
+    cerr << "Fatal: Built without OSMesa support (-DUSE_OSMESA)" << endl;
+    exit(EXIT_FAILURE);
+#endif
+}
+
+static void createFrameBuffer(GLint width, GLint height){
+    glGenRenderbuffers(1, &colorBufferID);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBufferID);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &depthBufferID);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBufferID);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+    glGenFramebuffers(1, &frameBufferID);
+    glBindFramebuffer(GL_FRAMEBUFFER, frameBufferID);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBufferID);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBufferID);
+    assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE
+           && "Offscreen framebuffer is incomplete");
+
+    glViewport(0, 0, width, height);
+}
+
+void createContext(GLint width, GLint height){
+    glewExperimental = GL_TRUE;
+    frameWidth = width;
+    frameHeight = height;
+
+    if (context.backend == BACKEND_EGL) createEGLContext();
+    else if (context.backend == BACKEND_OSMESA) createOSMesaContext(width, height);
+    else createWindowContext(width, height);
+
+    // GLEW built against GLX reports a missing X display on EGL contexts,
+    // but the GL entry points are still loaded
+    GLenum glewStatus = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    if (glewStatus == GLEW_ERROR_NO_GLX_DISPLAY) glewStatus = GLEW_OK;
+#endif
+    assert(glewStatus == GLEW_OK && "Could not initialize GLEW");
+
+    if (context.backend != BACKEND_WINDOW){
+        createFrameBuffer(width, height);
+        cerr << "Headless context: " << glGetString(GL_VERSION) << ", "
+             << glGetString(GL_RENDERER) << endl;
+    }
+}
+
+void destroyContext(){
+    if (frameBufferID){
+        glDeleteFramebuffers(1, &frameBufferID);
+        glDeleteRenderbuffers(1, &colorBufferID);
+        glDeleteRenderbuffers(1, &depthBufferID);
+        frameBufferID = 0;
+    }
+
+#ifdef USE_EGL
+    if (eglContext != EGL_NO_CONTEXT){
+        eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(eglDisplay, eglContext);
+        eglTerminate(eglDisplay);
+        eglContext = EGL_NO_CONTEXT;
+    }
+#endif
+
+#ifdef USE_OSMESA
+    if (osmesaContext){
+        OSMesaDestroyContext(osmesaContext);
+        osmesaContext = NULL;
+    }
+#endif
+
+    if (window){
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        window = NULL;
+    }
+}
+
+bool contextShouldClose(){
+    if (context.frames > 0 && framesRendered >= context.frames) return true;
+    return window && glfwWindowShouldClose(window);
+}
+
+void contextPollEvents(){
+    if (window) glfwPollEvents();
+}
+
+// Writes the bound framebuffer as a binary PPM, flipped to top-down rows
+static void writeFrame(){
+    if (context.output.empty()) return;
+
+    int rowBytes = frameWidth * 3;
+    framePixels.resize(rowBytes * frameHeight);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, frameWidth, frameHeight, GL_RGB, GL_UNSIGNED_BYTE, framePixels.data());
+
+    FILE *fp = stdout;
+    if (context.output != "-"){
+        char fileName[1024];
+        snprintf(fileName, sizeof(fileName), context.output.c_str(), framesRendered);
+        fp = fopen(fileName, "wb");
+        if (!fp){
+            cerr << "Could not open " << fileName << " for writing" << endl;
+            return;
+        }
+    }
+
+    fprintf(fp, "P6\n%d %d\n255\n", frameWidth, frameHeight);
+    for (int y = frameHeight - 1; y >= 0; y--)
+        fwrite(framePixels.data() + y * rowBytes, 1, rowBytes, fp);
+
+    if (fp == stdout) fflush(fp);
+    else fclose(fp);
+}
+
+void contextSwapBuffers(){
+    if (window) glfwSwapBuffers(window);
+    else writeFrame();
+    framesRendered++;
+}
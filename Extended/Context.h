@@ -0,0 +1,44 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <string>
+
+// Where the GL 3.3 core context comes from. The headless backends have no
+// default framebuffer, so they render into an offscreen FBO instead.
+enum contextBackend {
+    BACKEND_WINDOW,
+    BACKEND_EGL,     // EGL_MESA_platform_surfaceless, built with -DUSE_EGL
+    BACKEND_OSMESA   // Off-screen Mesa, built with -DUSE_OSMESA
+};
+
+struct contextOptions {
+    contextBackend backend;
+    int frames;          // Frames to render before closing, 0 runs until closed
+    std::string output;  // printf pattern for PPM frame files, "-" for stdout, "" for none
+};
+
+extern GLFWwindow* window;
+extern contextOptions context;
+extern GLuint frameBufferID; // Offscreen target, 0 for the window backend
+
+// Parses --headless[=egl|osmesa], --frames N and --output PATTERN|-|none.
+// Headless runs default to one frame written to frame0000.ppm.
+void parseContextOptions(int argc, char *argv[]);
+
+// Whether pattern is safe to hand snprintf with one int: at most one %d,
+// optionally %0Nd, and no other conversion but %%
+bool validFramePattern(std::string const& pattern);
+
+void createContext(GLint width, GLint height);
+void destroyContext();
+
+bool contextShouldClose();
+void contextPollEvents();
+
+// Presents the frame: swaps the window or reads back and writes the FBO
+void contextSwapBuffers();
+
+#endif
@@ -0,0 +1,223 @@
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <assert.h>
+
+#include "Cull.h"
+
+using namespace std;
+
+bounds2D computeBounds(const GLfloat *vertices, GLuint count, int stride){
+    bounds2D bounds = {numeric_limits<GLfloat>::max(), numeric_limits<GLfloat>::max(),
+                       -numeric_limits<GLfloat>::max(), -numeric_limits<GLfloat>::max()};
+    for (GLuint i = 0; i < count; i++, vertices += stride){
+        bounds.minX = min(bounds.minX, vertices[0]);
+        bounds.minY = min(bounds.minY, vertices[1]);
+        bounds.maxX = max(bounds.maxX, vertices[0]);
+        bounds.maxY = max(bounds.maxY, vertices[1]);
+    }
+    return bounds;
+}
+
+bounds2D visibleBounds(glm::mat4 const& mvp, GLfloat margin){
+    // The corners of clip space, taken back to model space at z = 0
+    glm::mat4 inverse = glm::inverse(mvp);
+    GLfloat corners[4][2] = {{-1.0f, -1.0f}, {1.0f, -1.0f}, {-1.0f, 1.0f}, {1.0f, 1.0f}};
+    bounds2D bounds = {numeric_limits<GLfloat>::max(), numeric_limits<GLfloat>::max(),
+                       -numeric_limits<GLfloat>::max(), -numeric_limits<GLfloat>::max()};
+    for (int i = 0; i < 4; i++){
+        glm::vec4 corner = inverse * glm::vec4(corners[i][0], corners[i][1], 0.0f, 1.0f);
+        bounds.minX = min(bounds.minX, corner.x / corner.w);
+        bounds.minY = min(bounds.minY, corner.y / corner.w);
+        bounds.maxX = max(bounds.maxX, corner.x / corner.w);
+        bounds.maxY = max(bounds.maxY, corner.y / corner.w);
+    }
+    bounds.minX -= margin;
+    bounds.minY -= margin;
+    bounds.maxX += margin;
+    bounds.maxY += margin;
+    return bounds;
+}
+
+bool boundsOverlap(bounds2D const& a, bounds2D const& b){
+    return a.minX <= b.maxX && b.minX <= a.maxX && a.minY <= b.maxY && b.minY <= a.maxY;
+}
+
+bounds2D transformBounds(bounds2D const& bounds, glm::mat4 const& model){
+    GLfloat corners[4][2] = {{bounds.minX, bounds.minY}, {bounds.maxX, bounds.minY},
+                             {bounds.minX, bounds.maxY}, {bounds.maxX, bounds.maxY}};
+    bounds2D moved = {numeric_limits<GLfloat>::max(), numeric_limits<GLfloat>::max(),
+                      -numeric_limits<GLfloat>::max(), -numeric_limits<GLfloat>::max()};
+    for (int i = 0; i < 4; i++){
+        glm::vec4 corner = model * glm::vec4(corners[i][0], corners[i][1], 0.0f, 1.0f);
+        moved.minX = min(moved.minX, corner.x / corner.w);
+        moved.minY = min(moved.minY, corner.y / corner.w);
+        moved.maxX = max(moved.maxX, corner.x / corner.w);
+        moved.maxY = max(moved.maxY, corner.y / corner.w);
+    }
+    return moved;
+}
+
+static GLuint64 cellKey(GLint x, GLint y){
+    return ((GLuint64)(GLuint)x << 32) | (GLuint)y;
+}
+
+// Coordinates further out, or NaN, share the outermost cells. The cast is
+// then defined, and the cell loops can step past their last cell without
+// overflowing. Bounds that reach this far from the origin are large, and
+// a view that does visits every occupied cell instead.
+static const GLint CELL_LIMIT = 1 << 30;
+
+static GLint cellOf(cullGrid const* grid, GLfloat coordinate){
+    GLfloat cell = floor(coordinate / grid->cellSize);
+    if (!(cell > (GLfloat)-CELL_LIMIT)) return -CELL_LIMIT; // And NaN
+    if (!(cell < (GLfloat)CELL_LIMIT)) return CELL_LIMIT;
+    return (GLint)cell;
+}
+
+void createCullGrid(cullGrid *grid, GLfloat cellSize){
+    assert(cellSize > 0.0f && "Cull grid cells need a size");
+    deleteCullGrid(grid);
+    grid->cellSize = cellSize;
+    grid->stamp = 0;
+    grid->nextOrder = 0;
+}
+
+void deleteCullGrid(cullGrid *grid){
+    grid->cells.clear();
+    grid->large.clear();
+    grid->entries.clear();
+    grid->freeHandles.clear();
+    grid->found.clear();
+}
+
+static void eraseHandle(vector<GLuint> *list, GLuint handle){
+    vector<GLuint>::iterator it = find(list->begin(), list->end(), handle);
+    assert(it != list->end() && "Cull grid lost track of an object");
+    *it = list->back();
+    list->pop_back();
+}
+
+static void link(cullGrid *grid, GLuint handle){
+    cullEntry &entry = grid->entries[handle];
+    entry.cellX0 = cellOf(grid, entry.bounds.minX);
+    entry.cellY0 = cellOf(grid, entry.bounds.minY);
+    entry.cellX1 = cellOf(grid, entry.bounds.maxX);
+    entry.cellY1 = cellOf(grid, entry.bounds.maxY);
+
+    double cellCount = ((double)entry.cellX1 - entry.cellX0 + 1) * ((double)entry.cellY1 - entry.cellY0 + 1);
+    entry.large = cellCount > CULL_MAX_CELLS;
+    if (entry.large){
+        grid->large.push_back(handle);
+        return;
+    }
+    for (GLint y = entry.cellY0; y <= entry.cellY1; y++)
+        for (GLint x = entry.cellX0; x <= entry.cellX1; x++)
+            grid->cells[cellKey(x, y)].push_back(handle);
+}
+
+static void unlink(cullGrid *grid, GLuint handle){
+    cullEntry const& entry = grid->entries[handle];
+    if (entry.large){
+        eraseHandle(&grid->large, handle);
+        return;
+    }
+    for (GLint y = entry.cellY0; y <= entry.cellY1; y++){
+        for (GLint x = entry.cellX0; x <= entry.cellX1; x++){
+            unordered_map<GLuint64, vector<GLuint> >::iterator cell = grid->cells.find(cellKey(x, y));
+            eraseHandle(&cell->second, handle);
+            if (cell->second.empty()) grid->cells.erase(cell);
+        }
+    }
+}
+
+GLuint cullInsert(cullGrid *grid, bounds2D const& bounds, void *object){
+    assert(object != NULL && "Cull grid objects cannot be NULL");
+
+    GLuint handle;
+    if (grid->freeHandles.empty()){
+        handle = grid->entries.size();
+        grid->entries.push_back(cullEntry());
+    } else {
+        handle = grid->freeHandles.back();
+        grid->freeHandles.pop_back();
+    }
+
+    cullEntry &entry = grid->entries[handle];
+    entry.bounds = bounds;
+    entry.object = object;
+    entry.stamp = grid->stamp;
+    entry.order = grid->nextOrder++;
+    link(grid, handle);
+    return handle;
+}
+
+void cullMove(cullGrid *grid, GLuint handle, bounds2D const& bounds){
+    cullEntry &entry = grid->entries[handle];
+    assert(entry.object != NULL && "Moving a removed object");
+
+    // Staying within the same cells leaves the lists alone
+    if (!entry.large && cellOf(grid, bounds.minX) == entry.cellX0 && cellOf(grid, bounds.minY) == entry.cellY0 &&
+        cellOf(grid, bounds.maxX) == entry.cellX1 && cellOf(grid, bounds.maxY) == entry.cellY1){
+        entry.bounds = bounds;
+        return;
+    }
+    unlink(grid, handle);
+    entry.bounds = bounds;
+    link(grid, handle);
+}
+
+void cullRemove(cullGrid *grid, GLuint handle){
+    assert(grid->entries[handle].object != NULL && "Removing an object twice");
+    unlink(grid, handle);
+    grid->entries[handle].object = NULL;
+    grid->freeHandles.push_back(handle);
+}
+
+// Adds the handles in list that overlap view and were not found already
+static void collect(cullGrid *grid, vector<GLuint> const& list, bounds2D const& view){
+    for (size_t i = 0; i < list.size(); i++){
+        cullEntry &entry = grid->entries[list[i]];
+        if (entry.stamp == grid->stamp || !boundsOverlap(entry.bounds, view)) continue;
+        entry.stamp = grid->stamp;
+        grid->found.push_back(list[i]);
+    }
+}
+
+void cullQuery(cullGrid *grid, bounds2D const& view, vector<void*> *visible){
+    // Stamps tell objects listed in several cells apart from new ones
+    if (++grid->stamp == 0){
+        for (size_t i = 0; i < grid->entries.size(); i++) grid->entries[i].stamp = 0;
+        grid->stamp = 1;
+    }
+    grid->found.clear();
+
+    GLint x0 = cellOf(grid, view.minX), y0 = cellOf(grid, view.minY);
+    GLint x1 = cellOf(grid, view.maxX), y1 = cellOf(grid, view.maxY);
+    double viewCells = ((double)x1 - x0 + 1) * ((double)y1 - y0 + 1);
+    if (viewCells > grid->cells.size()){
+        // Zoomed far out, visiting every occupied cell is cheaper
+        unordered_map<GLuint64, vector<GLuint> >::iterator it;
+        for (it = grid->cells.begin(); it != grid->cells.end(); ++it)
+            collect(grid, it->second, view);
+    } else {
+        for (GLint y = y0; y <= y1; y++){
+            for (GLint x = x0; x <= x1; x++){
+                unordered_map<GLuint64, vector<GLuint> >::iterator cell = grid->cells.find(cellKey(x, y));
+                if (cell != grid->cells.end()) collect(grid, cell->second, view);
+            }
+        }
+    }
+    collect(grid, grid->large, view);
+
+    vector<cullEntry> const& entries = grid->entries;
+    sort(grid->found.begin(), grid->found.end(),
+         [&entries](GLuint a, GLuint b){ return entries[a].order < entries[b].order; });
+    visible->resize(grid->found.size());
+    for (size_t i = 0; i < grid->found.size(); i++)
+        (*visible)[i] = grid->entries[grid->found[i]].object;
+}
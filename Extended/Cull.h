@@ -0,0 +1,68 @@
+#ifndef CULL_H
+#define CULL_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <unordered_map>
+
+// Axis-aligned rectangle in model space
+struct bounds2D {
+    GLfloat minX, minY, maxX, maxY;
+};
+
+// Bounds of count vertices that lie stride floats apart, x and y first
+bounds2D computeBounds(const GLfloat *vertices, GLuint count, int stride);
+
+// What an orthographic MVP shows, in model space, grown by margin on every
+// side to cover point sprites and wide lines drawn from vertices outside it
+bounds2D visibleBounds(glm::mat4 const& mvp, GLfloat margin);
+
+bool boundsOverlap(bounds2D const& a, bounds2D const& b);
+
+// Bounds of the rectangle once model takes it into world space, such as an
+// objectBuffer record's transform
+bounds2D transformBounds(bounds2D const& bounds, glm::mat4 const& model);
+
+// Objects that span more cells than this are tested on every query instead
+static const int CULL_MAX_CELLS = 64;
+
+struct cullEntry {
+    bounds2D bounds;
+    void *object; // NULL once removed
+    GLint cellX0, cellY0, cellX1, cellY1;
+    bool large;
+    GLuint stamp; // Last query that reported it
+    GLuint64 order; // When it was inserted, handles are reused so they can't tell
+};
+
+// Uniform grid of square cells, hashed so the scene needs no fixed extent.
+// Each object is listed in every cell its bounds touch, so a query only
+// visits the objects near the view, and moving an object only touches the
+// cells it leaves and enters.
+struct cullGrid {
+    GLfloat cellSize; // About the size of a typical object works best
+    std::unordered_map<GLuint64, std::vector<GLuint> > cells;
+    std::vector<GLuint> large;
+    std::vector<cullEntry> entries; // Indexed by handle
+    std::vector<GLuint> freeHandles;
+    std::vector<GLuint> found; // Scratch space for queries
+    GLuint stamp;
+    GLuint64 nextOrder;
+};
+
+void createCullGrid(cullGrid *grid, GLfloat cellSize);
+void deleteCullGrid(cullGrid *grid);
+
+// Returns the handle to move or remove the object with
+GLuint cullInsert(cullGrid *grid, bounds2D const& bounds, void *object);
+void cullMove(cullGrid *grid, GLuint handle, bounds2D const& bounds);
+void cullRemove(cullGrid *grid, GLuint handle);
+
+// Replaces visible with the objects whose bounds overlap view, in the order
+// they were inserted, so overlapping objects always draw in that order. An
+// object removed and inserted again counts as new.
+void cullQuery(cullGrid *grid, bounds2D const& view, std::vector<void*> *visible);
+
+#endif
@@ -0,0 +1,66 @@
+#include <GL/glew.h>
+
+#include <vector>
+#include <algorithm>
+#include <assert.h>
+
+#include "DrawList.h"
+#include "Jobs.h"
+
+using namespace std;
+
+void resetDrawList(drawList *list){
+    list->buffers.resize(jobThreadCount());
+    for (size_t i = 0; i < list->buffers.size(); i++){
+        list->buffers[i].commands.clear();
+        list->buffers[i].runs.clear();
+    }
+}
+
+commandBuffer *beginDrawRun(drawList *list, long key){
+    size_t index = jobThreadIndex();
+    assert(index < list->buffers.size() && "Draw list was reset before the job system started");
+
+    commandBuffer *buffer = &list->buffers[index];
+    drawRun run = {key, index, buffer->commands.size(), 0};
+    buffer->runs.push_back(run);
+    return buffer;
+}
+
+// Ties go by buffer, then by where in it the run was recorded, so equal
+// keys never leave the order to the sort
+static bool keyOrder(drawRun const& a, drawRun const& b){
+    if (a.key != b.key) return a.key < b.key;
+    if (a.buffer != b.buffer) return a.buffer < b.buffer;
+    return a.begin < b.begin;
+}
+
+size_t replayDrawList(drawList *list){
+    // A run ends where the next one in its buffer begins
+    list->runs.clear();
+    for (size_t i = 0; i < list->buffers.size(); i++){
+        commandBuffer &buffer = list->buffers[i];
+        for (size_t r = 0; r < buffer.runs.size(); r++){
+            drawRun run = buffer.runs[r];
+            run.end = r + 1 < buffer.runs.size() ? buffer.runs[r + 1].begin : buffer.commands.size();
+            if (run.end > run.begin) list->runs.push_back(run);
+        }
+    }
+    sort(list->runs.begin(), list->runs.end(), keyOrder);
+
+    size_t draws = 0;
+    for (size_t r = 0; r < list->runs.size(); r++){
+        drawRun const& run = list->runs[r];
+        const drawCommand *commands = &list->buffers[run.buffer].commands[0];
+        for (size_t i = run.begin; i < run.end; i++){
+            switch (commands[i].kind){
+                case DRAW_ARRAY:     drawArray((arrayObject*)commands[i].object); break;
+                case DRAW_TEXTURE:   drawArrayTexture((texturePolygon*)commands[i].object); break;
+                case DRAW_INSTANCED: drawArrayInstanced((instancedObject*)commands[i].object); break;
+                case DRAW_ELEMENTS:  drawElements((indexedMesh*)commands[i].object); break;
+            }
+        }
+        draws += run.end - run.begin;
+    }
+    return draws;
+}
@@ -0,0 +1,64 @@
+#ifndef DRAWLIST_H
+#define DRAWLIST_H
+
+#include <GL/glew.h>
+
+#include <vector>
+
+#include "Render.h"
+
+// Draws recorded on any thread and submitted on the GL thread. Each thread
+// records into its own commandBuffer, so recording takes no locks. Commands
+// come in runs, each with a key, usually the index of the first object the
+// job looked at. replayDrawList submits the runs of all buffers in key order,
+// so the frame draws in the same order whichever thread recorded what. Runs
+// that share a key go in buffer order, then in the order they were begun;
+// only distinct keys make that independent of the threads.
+
+enum drawKind {
+    DRAW_ARRAY,     // arrayObject
+    DRAW_TEXTURE,   // texturePolygon
+    DRAW_INSTANCED, // instancedObject
+    DRAW_ELEMENTS   // indexedMesh
+};
+
+struct drawCommand {
+    drawKind kind;
+    void *object;
+};
+
+struct drawRun {
+    long key;
+    size_t buffer;
+    size_t begin, end; // Commands of the buffer
+};
+
+struct commandBuffer {
+    std::vector<drawCommand> commands;
+    std::vector<drawRun> runs;
+    char padding[64]; // Keeps buffers of different threads off one cache line
+};
+
+struct drawList {
+    std::vector<commandBuffer> buffers; // Indexed by jobThreadIndex
+    std::vector<drawRun> runs;          // Scratch space for replays
+};
+
+// Empties the buffers, keeping their memory, and makes one for every job
+// thread. Call on the GL thread before recording.
+void resetDrawList(drawList *list);
+
+// Starts a run in the calling thread's buffer and returns that buffer
+commandBuffer *beginDrawRun(drawList *list, long key);
+
+inline void recordDraw(commandBuffer *buffer, drawKind kind, void *object){
+    drawCommand command = {kind, object};
+    buffer->commands.push_back(command);
+}
+
+// Submits every recorded draw, runs in key order, and returns how many there
+// were. The objects must still exist. Call on the GL thread once recording
+// has finished.
+size_t replayDrawList(drawList *list);
+
+#endif
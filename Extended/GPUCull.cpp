@@ -0,0 +1,191 @@
+#ifdef WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#endif
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+#include "GPUCull.h"
+#include "ProgramCache.h"
+#include "State.h"
+
+using namespace std;
+
+static_assert(sizeof(cullObject) == 32, "cullObject must match the std430 layout of cullObjects.comp");
+
+// The fields of a DrawArraysIndirectCommand
+static const int COMMAND_WORDS = 4;
+
+static GLuint cullProgram = 0;
+static GLint objectCountID = -1;
+static GLint marginID = -1;
+
+bool gpuCullSupported(){
+    // baseInstance in the commands is 4.2, compute shaders and their storage
+    // buffers 4.3, and cullObjects.comp is written against the latter
+    return GLEW_VERSION_4_3;
+}
+
+void batchArray(vector<indirectBatch> *batches, struct arrayObject *obj){
+    indirectBatch *batch = NULL;
+    for (size_t i = 0; i < batches->size(); i++){
+        if ((*batches)[i].vertexBuffer != 0) continue; // Uploaded, as in Batch.cpp
+        if ((*batches)[i].shader == obj->shader && (*batches)[i].mode == obj->mode){
+            batch = &(*batches)[i];
+            break;
+        }
+    }
+
+    if (batch == NULL){
+        indirectBatch newBatch;
+        newBatch.shader = obj->shader;
+        newBatch.mode = obj->mode;
+        newBatch.vertexBuffer = newBatch.colorBuffer = 0;
+        newBatch.objectBuffer = newBatch.commandBuffer = 0;
+        newBatch.vertexArrayID = 0;
+        newBatch.objectCount = 0;
+        newBatch.vertexCount = 0;
+        batches->push_back(newBatch);
+        batch = &batches->back();
+    }
+
+    batch->objects.push_back(obj);
+    batch->objectCount++;
+    batch->vertexCount += obj->vertexArrayLength / 3;
+}
+
+static void compileCullProgram(){
+    string cs = "";
+    if (fileRead("cullObjects.comp", &cs) < 0){
+        cerr << "Fatal: Could not read cullObjects.comp" << endl;
+        exit(EXIT_FAILURE);
+    }
+    cullProgram = compileComputeShader(cs);
+    objectCountID = glGetUniformLocation(cullProgram, "uObjectCount");
+    marginID = glGetUniformLocation(cullProgram, "uMargin");
+}
+
+void uploadBatches(vector<indirectBatch> *batches){
+    if (!batches->empty() && cullProgram == 0) compileCullProgram();
+
+    vector<GLfloat> positions, colors;
+    vector<cullObject> records;
+
+    for (size_t b = 0; b < batches->size(); b++){
+        indirectBatch *batch = &(*batches)[b];
+        if (batch->vertexBuffer != 0) continue; // Uploaded by an earlier call
+        positions.clear();
+        colors.clear();
+        records.clear();
+
+        for (size_t i = 0; i < batch->objects.size(); i++){
+            arrayObject *obj = batch->objects[i];
+            GLuint count = obj->vertexArrayLength / 3;
+            obj->bounds = computeBounds(obj->vertexArray, count, 3);
+
+            cullObject record = {obj->bounds, (GLuint)(positions.size() / 3), count, {0, 0}};
+            records.push_back(record);
+            positions.insert(positions.end(), obj->vertexArray, obj->vertexArray + count * 3);
+            colors.push_back(obj->colorVec.x);
+            colors.push_back(obj->colorVec.y);
+            colors.push_back(obj->colorVec.z);
+            obj->vertexArray = NULL;
+        }
+        batch->objects.clear();
+
+        stateGenBuffers(1, &batch->vertexBuffer, "indirect batch");
+        stateGenBuffers(1, &batch->colorBuffer, "indirect batch");
+        stateGenBuffers(1, &batch->objectBuffer, "indirect batch");
+        stateGenBuffers(1, &batch->commandBuffer, "indirect batch");
+        stateBindBuffer(GL_ARRAY_BUFFER, batch->vertexBuffer);
+        stateBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * positions.size(), positions.data(), GL_STATIC_DRAW);
+        stateBindBuffer(GL_ARRAY_BUFFER, batch->colorBuffer);
+        stateBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * colors.size(), colors.data(), GL_STATIC_DRAW);
+        stateBindBuffer(GL_SHADER_STORAGE_BUFFER, batch->objectBuffer);
+        stateBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(cullObject) * records.size(), records.data(), GL_STATIC_DRAW);
+        stateBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch->commandBuffer);
+        stateBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(GLuint) * COMMAND_WORDS * batch->objectCount,
+                        NULL, GL_DYNAMIC_COPY);
+
+        glGenVertexArrays(1, &batch->vertexArrayID);
+        stateBindVertexArray(batch->vertexArrayID);
+        stateBindBuffer(GL_ARRAY_BUFFER, batch->vertexBuffer);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+        glEnableVertexAttribArray(0);
+        stateBindBuffer(GL_ARRAY_BUFFER, batch->colorBuffer);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+        glVertexAttribDivisor(2, 1); // Every draw is one instance, starting at its object
+        glEnableVertexAttribArray(2);
+    }
+}
+
+void drawBatches(vector<indirectBatch> *batches){
+    if (batches->empty()) return;
+
+    stateUseProgram(cullProgram);
+    stateUniform1f(cullProgram, marginID, CULL_MARGIN);
+    for (size_t b = 0; b < batches->size(); b++){
+        indirectBatch *batch = &(*batches)[b];
+        stateUniform1i(cullProgram, objectCountID, batch->objectCount);
+        stateBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_OBJECT_BINDING, batch->objectBuffer);
+        stateBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_COMMAND_BINDING, batch->commandBuffer);
+        glDispatchCompute((batch->objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+    }
+
+    // One barrier for every batch, the draws wait for all of the culls
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+
+    for (size_t b = 0; b < batches->size(); b++){
+        indirectBatch *batch = &(*batches)[b];
+        stateUseProgram(batch->shader);
+        stateBindVertexArray(batch->vertexArrayID);
+        stateBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch->commandBuffer);
+        glMultiDrawArraysIndirect(batch->mode, (void*)0, batch->objectCount, 0);
+    }
+
+    // Read per instance here, drawArray sets it as a constant
+    stateInvalidateAttribute(2);
+}
+
+GLsizei countVisible(vector<indirectBatch> *batches){
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    GLsizei visible = 0;
+    for (size_t b = 0; b < batches->size(); b++){
+        indirectBatch *batch = &(*batches)[b];
+        stateBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch->commandBuffer);
+        GLsizeiptr bytes = sizeof(GLuint) * COMMAND_WORDS * batch->objectCount;
+        const GLuint *commands = (const GLuint*)glMapBufferRange(GL_DRAW_INDIRECT_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+        if (!commands){
+            cerr << "Could not map the draw commands of an indirect batch" << endl;
+            continue;
+        }
+        for (GLsizei i = 0; i < batch->objectCount; i++)
+            if (commands[i * COMMAND_WORDS + 1]) visible++;
+        glUnmapBuffer(GL_DRAW_INDIRECT_BUFFER);
+    }
+    return visible;
+}
+
+void deleteBatches(vector<indirectBatch> *batches){
+    for (size_t b = 0; b < batches->size(); b++){
+        indirectBatch *batch = &(*batches)[b];
+        stateDeleteBuffers(1, &batch->vertexBuffer);
+        stateDeleteBuffers(1, &batch->colorBuffer);
+        stateDeleteBuffers(1, &batch->objectBuffer);
+        stateDeleteBuffers(1, &batch->commandBuffer);
+        stateDeleteVertexArrays(1, &batch->vertexArrayID);
+    }
+    batches->clear();
+}
+
+void finishGPUCull(){
+    if (cullProgram) releaseProgram(cullProgram);
+    cullProgram = 0;
+}
@@ -0,0 +1,69 @@
+#ifndef GPUCULL_H
+#define GPUCULL_H
+
+#include <GL/glew.h>
+
+#include <vector>
+
+#include "Cull.h"
+#include "Render.h"
+
+// Objects sharing a shader and primitive mode, packed into one VBO like an
+// arrayBatch but culled on the GPU. Their bounds sit in a shader storage
+// buffer, and each frame cullObjects.comp tests them against the view the
+// MVP shows and writes a DrawArraysIndirectCommand per object. One
+// glMultiDrawArraysIndirect then draws the batch without the CPU looking at
+// a single object. Culled objects keep their command with no instances, so
+// the draw order, and with it depth ties, stays that of the objects.
+//
+// Needs GL 4.3. Without it, draw the objects one by one through a cullGrid.
+
+static const GLuint CULL_OBJECT_BINDING = 0;  // Shader storage bindings of cullObjects.comp
+static const GLuint CULL_COMMAND_BINDING = 1;
+static const GLuint CULL_GROUP_SIZE = 64;     // Its local_size_x
+
+// One object's record in objectBuffer, laid out as std430
+struct cullObject {
+    bounds2D bounds;
+    GLuint first; // Vertices into the batch
+    GLuint count;
+    GLuint padding[2];
+};
+
+struct indirectBatch {
+    GLuint shader;
+    GLuint mode;
+    GLuint vertexBuffer;  // Positions
+    GLuint colorBuffer;   // One color per object, picked by baseInstance
+    GLuint objectBuffer;  // cullObject records
+    GLuint commandBuffer; // Written by the cull, read by the draw
+    GLuint vertexArrayID;
+    std::vector<struct arrayObject*> objects; // Only until uploadBatches
+    GLsizei objectCount;
+    GLsizei vertexCount;
+};
+
+// Whether the context has compute shaders and indirect draws
+bool gpuCullSupported();
+
+// Adds an object that has not been uploaded yet, as batchArray does
+void batchArray(std::vector<indirectBatch> *batches, struct arrayObject *obj);
+
+// Packs and uploads every batch, sets each object's bounds and drops its CPU
+// geometry. Compiles cullObjects.comp the first time. Uploaded once, like
+// an arrayBatch.
+void uploadBatches(std::vector<indirectBatch> *batches);
+
+// Culls every batch against the current Frame block, then draws it
+void drawBatches(std::vector<indirectBatch> *batches);
+
+// Objects the last drawBatches let through. Reads the commands back, so it
+// waits for the GPU; for checking and statistics only.
+GLsizei countVisible(std::vector<indirectBatch> *batches);
+
+void deleteBatches(std::vector<indirectBatch> *batches);
+
+// Releases the cull program. Call before destroying the context.
+void finishGPUCull();
+
+#endif
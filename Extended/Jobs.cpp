@@ -0,0 +1,149 @@
+#include <vector>
+#include <deque>
+#include <memory>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "Jobs.h"
+
+using namespace std;
+
+struct job {
+    jobFunction run;
+    void *data;
+    long begin, end, grain;
+    atomic<long> *remaining; // Items of the parallelFor not yet run
+};
+
+// The owner pushes and pops at the back, thieves take from the front. Each
+// queue has its own lock; thieves only come once their own queue is empty,
+// so it is rarely contended.
+struct jobQueue {
+    mutex lock;
+    deque<job> jobs;
+};
+
+static vector<unique_ptr<jobQueue> > queues; // One per thread, 0 is the GL thread
+static vector<thread> workers;
+static atomic<long> queuedJobs(0);
+
+// Guards stopping, and orders pushes with workers going to sleep
+static mutex sleepMutex;
+static condition_variable workQueued;
+static bool stopping = false;
+
+static thread_local int threadIndex = 0;
+
+static void pushJob(job const& next){
+    jobQueue &queue = *queues[threadIndex];
+    {
+        lock_guard<mutex> lock(queue.lock);
+        queue.jobs.push_back(next);
+    }
+    queuedJobs++;
+    { lock_guard<mutex> lock(sleepMutex); } // A worker checking queuedJobs has either seen it or is waiting
+    workQueued.notify_one();
+}
+
+static bool takeJob(jobQueue *queue, bool own, job *next){
+    lock_guard<mutex> lock(queue->lock);
+    if (queue->jobs.empty()) return false;
+    if (own){
+        *next = queue->jobs.back();
+        queue->jobs.pop_back();
+    } else {
+        *next = queue->jobs.front();
+        queue->jobs.pop_front();
+    }
+    queuedJobs--;
+    return true;
+}
+
+// The newest job of this thread's queue, else the oldest of another's
+static bool popJob(job *next){
+    int count = queues.size();
+    if (takeJob(queues[threadIndex].get(), true, next)) return true;
+    for (int i = 1; i < count; i++)
+        if (takeJob(queues[(threadIndex + i) % count].get(), false, next)) return true;
+    return false;
+}
+
+static void runJob(job next){
+    // Halving leaves the biggest pieces at the front, where thieves look
+    while (next.end - next.begin > next.grain){
+        job upper = next;
+        upper.begin = next.begin + (next.end - next.begin) / 2;
+        pushJob(upper);
+        next.end = upper.begin;
+    }
+    next.run(next.data, next.begin, next.end);
+    *next.remaining -= next.end - next.begin;
+}
+
+static void workerLoop(int index){
+    threadIndex = index;
+    while (true){
+        job next;
+        if (popJob(&next)){
+            runJob(next);
+            continue;
+        }
+        unique_lock<mutex> lock(sleepMutex);
+        workQueued.wait(lock, []{ return stopping || queuedJobs > 0; });
+        if (stopping) return;
+    }
+}
+
+void startJobSystem(int threads){
+    if (!workers.empty()) return;
+    if (threads <= 0){
+        unsigned int hardware = thread::hardware_concurrency();
+        threads = hardware > 1 ? hardware - 1 : 0; // Leaves a core to the GL thread
+    }
+
+    stopping = false;
+    queues.clear();
+    for (int i = 0; i <= threads; i++) queues.push_back(unique_ptr<jobQueue>(new jobQueue()));
+    for (int i = 1; i <= threads; i++) workers.push_back(thread(workerLoop, i));
+}
+
+void stopJobSystem(){
+    {
+        lock_guard<mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    workQueued.notify_all();
+    for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+    workers.clear();
+    queues.clear();
+}
+
+int jobThreadCount(){
+    return workers.size() + 1;
+}
+
+int jobThreadIndex(){
+    return threadIndex;
+}
+
+void parallelFor(long count, long grain, jobFunction run, void *data){
+    if (count <= 0) return;
+    if (workers.empty()){
+        run(data, 0, count);
+        return;
+    }
+
+    atomic<long> remaining(count);
+    job first = {run, data, 0, count, max(1L, grain), &remaining};
+    runJob(first);
+
+    // Help with whatever is queued, this range or another, until it is done
+    while (remaining > 0){
+        job next;
+        if (popJob(&next)) runJob(next);
+        else this_thread::yield();
+    }
+}
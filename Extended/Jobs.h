@@ -0,0 +1,32 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+// A pool of worker threads that share work by stealing. A parallelFor hands
+// its whole range to the calling thread's queue. Whoever runs a range keeps
+// splitting it in half, queueing the upper half, until a piece is no larger
+// than the grain. Idle threads steal the oldest, and so largest, piece from
+// another queue. Jobs never touch GL; they prepare work the GL thread then
+// submits.
+
+// Starts the workers, 0 picks one less than the hardware threads. The thread
+// that calls this counts as thread 0 and should be the GL thread.
+void startJobSystem(int threads);
+
+// Joins the workers, which must be idle
+void stopJobSystem();
+
+// Workers plus the GL thread, what per-thread buffers are sized by
+int jobThreadCount();
+
+// 0 on the GL thread, 1..jobThreadCount() - 1 on the workers
+int jobThreadIndex();
+
+typedef void (*jobFunction)(void *data, long begin, long end);
+
+// Runs run over [0, count) in pieces of at most grain items and returns once
+// all have finished. The caller works on the range too. Jobs may start
+// parallelFors of their own. Without workers, as before startJobSystem, it
+// runs in the caller as one piece.
+void parallelFor(long count, long grain, jobFunction run, void *data);
+
+#endif
@@ -23,290 +23,42 @@
 #include <fstream>
 #include <assert.h>
 
-#define PNG_DEBUG 3
-#define PNG_SIG_BYTES 8
-#include <png.h>
+#include "Arena.h"
+#include "BufferPool.h"
+#include "Capture.h"
+#include "Context.h"
+#include "Mesh.h"
+#include "Profiler.h"
+#include "ProgramCache.h"
+#include "Render.h"
+#include "RenderPolicy.h"
+#include "Resolution.h"
+#include "SceneFile.h"
+#include "State.h"
+#include "TextureCache.h"
+#include "TextureLoader.h"
+#include "Uniforms.h"
 
 using namespace std;
 
-GLint width = 1024;
-GLint height = 576;
-GLFWwindow* window;
-GLuint VertexArrayID;
-
-struct arrayObject {
-    GLuint mode;
-    GLuint shader;
-    glm::vec3 colorVec;
-    GLuint vertexBuffer;
-    GLfloat vertexArray[1024]; // Should be deleted after upload
-    GLuint vertexArrayLength;
-    GLuint programObject;
-    GLuint uniform;
-};
-
-struct texturePolygon {
-    GLuint texture;
-    GLuint shader;
-    GLint textureID;
-    GLuint matrixID;
-    GLuint vertexBuffer;
-    GLuint uvBuffer;
-    GLfloat vertexBufferArray[1024];
-    GLfloat uvBufferArray[1024];
-    GLuint arrayLength;
-};
-
-float matrix[16] = {
-    1.0f / ((float)width/2.0f), 0.0f, 0.0f, 0.0f,
-    0.0f, 1.0f / ((float)height/2.0f), 0.0f, 0.0f,
-    0.0f, 0.0f, 1.0f, 0.0f,
-    0.0f, 0.0f, 0.0f, 1.0f
-};
-
-// Static Model-View-Projection matrix
-glm::mat4 MVP = glm::make_mat4(matrix);
-
-static void keyboardCallback(GLFWwindow* window, int key, int scancode,
-                             int action, int mods){
-    if(key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, GL_TRUE);
-}
-
-static void uploadArray(struct arrayObject *obj){
-    glBindBuffer(GL_ARRAY_BUFFER, obj->vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * obj->vertexArrayLength,
-                 obj->vertexArray, GL_STATIC_DRAW);
-}
-
-static void uploadArray(struct texturePolygon *obj){
-    glBindBuffer(GL_ARRAY_BUFFER, obj->vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 3 * obj->arrayLength, obj->vertexBufferArray, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ARRAY_BUFFER, obj->uvBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 2 * obj->arrayLength, obj->uvBufferArray, GL_STATIC_DRAW);
-}
-
-static void drawArray(struct arrayObject *obj){
-    glUseProgram(obj->shader);
-
-    glUniform3fv(obj->uniform, 1, glm::value_ptr(obj->colorVec));
-    glUniformMatrix4fv(obj->programObject, 1, GL_FALSE, glm::value_ptr(MVP));
-
-    glBindBuffer(GL_ARRAY_BUFFER, obj->vertexBuffer);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-    glDrawArrays(obj->mode, 0, obj->vertexArrayLength);
-}
-
-static void drawArrayTexture(struct texturePolygon *obj){
-    glUseProgram(obj->shader);
-    glUniformMatrix4fv(obj->matrixID, 1, GL_FALSE, &MVP[0][0]);
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, obj->texture);
-    glUniform1i(obj->textureID, 0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, obj->vertexBuffer);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,0,(void*)0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, obj->uvBuffer);
-    glVertexAttribPointer(1,2,GL_FLOAT,GL_FALSE,0,(void*)0);
-
-    glDrawArrays(GL_TRIANGLES, 0, 12*3);
-}
-
-static void getUniform(struct arrayObject *obj){
-    obj->programObject = glGetUniformLocation(obj->shader, "uModelMatrix");
-    obj->uniform = glGetUniformLocation(obj->shader, "uColorVec");
-}
-
-static void getUniform(struct texturePolygon *obj){
-    obj->textureID = glGetUniformLocation(obj->shader, "myTextureSampler");
-    obj->matrixID = glGetUniformLocation(obj->shader, "MVP");
-}
-
-static void init(){
-    glewExperimental = GL_TRUE;
-
-    assert(glfwInit() == true  && "Could not initialize GLFW");
-
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
-
-    window = glfwCreateWindow(width, height,"title", NULL, NULL);
-    assert(window != NULL && "Could not initialize window");
-    glfwMakeContextCurrent(window);
-    assert(glewInit() == GLEW_OK && "Could not initialize GLEW");
-
-    glfwSetKeyCallback(window, keyboardCallback); // Set GLFW call back function
-
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_GREATER);
-    glClearDepth(-1.0f);
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
-
-    // Create a Vertex Array Object
-    glGenVertexArrays(1, &VertexArrayID);
-    glBindVertexArray(VertexArrayID);
-}
-
-static int fileRead(string const& filename, string* result){
-    ifstream ifs(filename.data());
-    if(ifs.is_open()) {
-        *result = string((istreambuf_iterator<char>(ifs)),
-                              (istreambuf_iterator<char>()));
-        ifs.close();
-        return 0;
-    }
-    return -1;
-}
-
-static void printShaderError(GLuint shaderObj, GLenum shaderType, string const& msg){
-    GLchar errorLog[1024] = { 0 };
-    glGetShaderInfoLog(shaderObj, 1024, NULL, errorLog);
-    cout << msg << " " << shaderType << ": " << errorLog << endl;
-    exit(EXIT_FAILURE);
-}
-
-static void printProgramError(GLuint program, string const& msg){
-    GLchar errorLog[1024] = { 0 };
-    glGetProgramInfoLog(program, 1024, NULL, errorLog);
-    cout << msg << ": " << errorLog << endl;
-    exit(EXIT_FAILURE);
-}
-
-static void addShader(string const& shaderString, GLenum shaderType, GLuint m_program){
-    GLuint shaderObj = glCreateShader(shaderType);
-
-    if (shaderObj == 0){
-        cout << "Fatal: Error creating shader type ";
-        if (shaderType == GL_VERTEX_SHADER) cout << "GL_VERTEX_SHADER" << endl;
-        else if (shaderType == GL_FRAGMENT_SHADER) cout << "GL_FRAGMENT_SHADER" << endl;
-        exit(EXIT_FAILURE);
-    }
-
-    GLchar const* str = shaderString.data();
-    GLint length = shaderString.size();
-    glShaderSource(shaderObj, 1, &str, &length);
-    glCompileShader(shaderObj);
-
-    GLint success;
-    glGetShaderiv(shaderObj, GL_COMPILE_STATUS, &success);
-    if (success == 0)
-        printShaderError(shaderObj, shaderType, "Fatal: Error compiling shader type");
-
-    glAttachShader(m_program, shaderObj);
-}
-
-GLuint compileShader(string const& vs, string const& fs){
-    GLuint program = glCreateProgram();
-    assert(program != 0 && "Fatal: Error creating shader program.");
-
-    addShader(vs, GL_VERTEX_SHADER, program);
-    addShader(fs, GL_FRAGMENT_SHADER, program);
-
-    GLint success;
-    glLinkProgram(program);
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if(success == 0) {
-        printProgramError(program, "Fatal: Error linking shader program");
-    }
-
-    glValidateProgram(program);
-    glGetProgramiv(program, GL_VALIDATE_STATUS, &success);
-    if(success == 0) {
-        printProgramError(program, "Fatal: Invalid shader program");
-    }
-
-    return program;
-}
-
-GLuint read_png_file(const char * file_name, int * width, int * height){
-    png_byte header[8];
-
-    FILE *fp = fopen(file_name, "rb");
-    assert(fp && "Could not open PNG file");
-
-    fread(header, 1, 8, fp);
-    assert(!png_sig_cmp(header, 0, PNG_SIG_BYTES) && "File is not a PNG");
-
-    png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL,
-                                                 NULL, NULL);
-    assert(png_ptr && "Could not create read struct for PNG");
-
-    png_infop info_ptr = png_create_info_struct(png_ptr);
-    assert(info_ptr && "Could not create info struct");
-
-    png_infop end_info = png_create_info_struct(png_ptr);
-    assert(end_info && "Could not create end infomation");
-
-    assert(!setjmp(png_jmpbuf(png_ptr)) && "libpng encountered an error");
-
-    png_init_io(png_ptr, fp);
-    png_set_sig_bytes(png_ptr, PNG_SIG_BYTES);
-    png_read_info(png_ptr, info_ptr);
-
-    int bit_depth;
-    int color_type;
-    png_uint_32 temp_width;
-    png_uint_32 temp_height;
-    png_get_IHDR(png_ptr, info_ptr, &temp_width, &temp_height, &bit_depth,
-                 &color_type, NULL, NULL, NULL);
-
-    if (width){ *width = temp_width; }
-    if (height){ *height = temp_height; }
-
-
-    png_read_update_info(png_ptr, info_ptr);
-    int rowbytes = png_get_rowbytes(png_ptr, info_ptr);
-
-    // glTexImage2d requires rows to be 4-byte aligned
-    rowbytes += 3 - ((rowbytes-1) % 4);
-
-    // Allocate the image_data as a big block, to be given to opengl
-    png_byte * image_data;
-    image_data = (png_byte *) malloc(rowbytes * temp_height * sizeof(png_byte)+15);
-    assert(image_data != NULL && "Could not allocate memory for PNG image data");
-
-    // row_pointers is for pointing to image_data for reading the png with libpng
-    png_bytep * row_pointers = (png_bytep *)malloc(temp_height * sizeof(png_bytep));
-    assert(row_pointers != NULL && "Could not allocate memory for PNG row pointers");
-
-    // set the individual row_pointers to point at the correct offsets of image_data
-    for (int i = 0; i < temp_height; i++){
-        row_pointers[temp_height - 1 - i] = image_data + i * rowbytes;
-    }
-
-    // read the png into image_data through row_pointers
-    png_read_image(png_ptr, row_pointers);
-
-    // Generate the OpenGL texture object
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, temp_width, temp_height, 0, GL_RGB, GL_UNSIGNED_BYTE, image_data);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    // clean up
-    png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
-    free(image_data);
-    free(row_pointers);
-    fclose(fp);
-
-    return texture;
-}
-
+// Time each frame may spend finishing texture uploads
+static const double TEXTURE_BUDGET_MS = 2.0;
+// and streaming in scene chunks
+static const double SCENE_BUDGET_MS = 4.0;
 
 int main(int argc, char *argv[]){
+    parseContextOptions(argc, argv);
+    parseProfilerOptions(argc, argv);
+    parseProgramCacheOptions(argc, argv);
+    parseTextureCacheOptions(argc, argv);
+    parseRenderPolicyOptions(argc, argv);
+    parseCaptureOptions(argc, argv);
+    parseResolutionOptions(argc, argv);
+    const char *sceneName = NULL; // --scene FILE.glsc replaces dot, tri and line
+    for (int i = 1; i + 1 < argc; i++)
+        if (string(argv[i]) == "--scene") sceneName = argv[i + 1];
     init(); // Set OpenGL settings
+    applyRenderPolicy();
 
     // Load shaders
     string vs = "";
@@ -314,117 +66,177 @@ int main(int argc, char *argv[]){
     assert(fileRead("colorVertex.vert", &vs) >= 0);
     assert(fileRead("colorFragment.frag", &fs) >= 0);
 
-    // Create dots
+    string vs2 = "";
+    string fs2 = "";
+    assert(fileRead("textureVertex.vert", &vs2) >= 0);
+    assert(fileRead("textureFragment.frag", &fs2) >= 0);
+
+    // Programs compile in the background while the texture and geometry load
+    GLuint textureShader = compileShaderAsync(vs2, fs2);
+
+    // Geometry is built in this arena and released once it is uploaded
+    geometryArena loadArena = {};
+
+    // Create dots. dot, tri and line use the same sources, so they share one program.
     arrayObject dot = {GL_POINTS,
-                       compileShader(vs, fs),
+                       compileShaderAsync(vs, fs),
                        glm::vec3(1.0f, 1.0f, 0.0f),
                        (GLuint)NULL,
+                       arenaFloats(&loadArena,
                        {0.0f,0.0f,0.0f,10.0f,-10.0f,0.0f,20.0f,-20.0f,0.0f,
                         30.0f,-30.0f,0.0f,40.0f,-40.0f,0.0f,50.0f,-50.0f,0.0f,
-                        60.0f,-60.0f,0.0f},
+                        60.0f,-60.0f,0.0f}),
                        21};
 
     // Create triangle
     arrayObject tri = {GL_TRIANGLES,
-                       compileShader(vs, fs),
+                       compileShaderAsync(vs, fs),
                        glm::vec3(0.0f, 1.0f, 1.0f),
                        (GLuint)NULL,
-                       {50.0f,0.0f,0.0f,150.0f,100.0f,0.0f,0.0f,150.0f,0.0f},
+                       arenaFloats(&loadArena,
+                       {50.0f,0.0f,0.0f,150.0f,100.0f,0.0f,0.0f,150.0f,0.0f}),
                        9};
 
     // Create line
     arrayObject line = {GL_LINES,
-                        compileShader(vs, fs),
+                        compileShaderAsync(vs, fs),
                         glm::vec3(1.0f, 0.0f, 1.0f),
                         (GLuint)NULL,
-                        {150.0f,50.0f,0.0f,250.0f,350.0f,0.0f},
-                        4};
-
-    string vs2 = "";
-    string fs2 = "";
-    assert(fileRead("textureVertex.vert", &vs2) >= 0);
-    assert(fileRead("textureFragment.frag", &fs2) >= 0);
-
-    int *w = 0;
-    int *h = 0;
-    texturePolygon tex = {
-        read_png_file("test.png", w, h),
-        compileShader(vs2, fs2),
-        (GLint)NULL,
-        (GLint)NULL,
-        (GLint)NULL,
-        (GLint)NULL,
-        {100.0f, 0.0f, 0.0f,
-         0.0f, 100.0f, 0.0f,
-         100.0f, 100.0f, 0.0f,
-         0.0f, 0.0f, 0.0f,
-         0.0f, 100.0f, 0.0f,
-         100.0f, 0.0f, 0.0f
-        },
-        {1.0f, 0.0f,
-         0.0f, 1.0f,
-         1.0f, 1.0f,
-         0.0f, 0.0f,
-         0.0f, 1.0f,
-         1.0f, 0.0f
-        },
-        6};
-
-
-    glGenBuffers(1, &tex.vertexBuffer);
-    glGenBuffers(1, &tex.uvBuffer);
-
-    glGenBuffers(1, &dot.vertexBuffer);
-    glGenBuffers(1, &tri.vertexBuffer);
-    glGenBuffers(1, &line.vertexBuffer);
-
-    // Upload data array buffer to GPU
+                        arenaFloats(&loadArena,
+                        {150.0f,50.0f,0.0f,250.0f,350.0f,0.0f}),
+                        6};
+
+    // Decoded on the loader threads, drawn with a placeholder until uploaded.
+    // The quad's two triangles share an edge, so welding leaves four vertices.
+    indexedMesh tex = {loadTexture("test.png"), textureShader};
+    weldMesh(&tex, &loadArena,
+             arenaFloats(&loadArena,
+             {100.0f, 0.0f, 0.0f,
+              0.0f, 100.0f, 0.0f,
+              100.0f, 100.0f, 0.0f,
+              0.0f, 0.0f, 0.0f,
+              0.0f, 100.0f, 0.0f,
+              100.0f, 0.0f, 0.0f
+             }),
+             arenaFloats(&loadArena,
+             {1.0f, 0.0f,
+              0.0f, 1.0f,
+              1.0f, 1.0f,
+              0.0f, 0.0f,
+              0.0f, 1.0f,
+              1.0f, 0.0f
+             }),
+             6);
+    optimizeMesh(&tex);
+
+    // Everything here is flat, so positions drop z, and the UVs lie in 0..1
+    // and pack into 16 bits
+    dot.layout = tri.layout = line.layout = &compactPositionLayout;
+    tex.layout = &compactTextureLayout;
+
+    // Upload data array buffer to GPU. Without buffers of their own, the
+    // objects share a pooled one.
     uploadArray(&tex);
 
     uploadArray(&dot);
     uploadArray(&tri);
     uploadArray(&line);
+    arenaRelease(&loadArena);
 
-    // Get the uniform location of uploaded programs. You -must- refresh all
-    // uniforms, if you upload a new array.
-    getUniform(&tex);
+    // Mapped now, the chunks stream in over the first frames
+    sceneFile scene = {};
+    if (sceneName && !openSceneFile(sceneName, dot.shader, &scene)){
+        cerr << "Fatal: Could not load scene " << sceneName << endl;
+        exit(EXIT_FAILURE);
+    }
 
-    getUniform(&dot);
-    getUniform(&tri);
-    getUniform(&line);
+    // Objects are skipped until their program is ready. Captured frames have
+    // to be complete, so headless runs wait for every program and texture here.
+    if (context.backend != BACKEND_WINDOW){
+        finishPrograms();
+        finishTextures();
+        while (!streamSceneFile(&scene, visibleBounds(MVP, CULL_MARGIN), SCENE_BUDGET_MS));
+    }
+    bool textureUniformsReady = false;
+    bool colorUniformsReady = false;
+    bool loading = true; // The scene changes by itself until programs and textures are in
 
     // main loop
-    while(!glfwWindowShouldClose(window))
+    while(!contextShouldClose())
     {
-        glfwPollEvents();
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
-
-        drawArrayTexture(&tex);
-
-        drawArray(&dot);
-        drawArray(&tri);
-        drawArray(&line);
-
-        glDisableVertexAttribArray(0);
-        glDisableVertexAttribArray(1);
-        glfwSwapBuffers(window);
+        waitForFrame(loading); // Idle time, outside the frame
+        profilerBeginFrame();
+        { PROFILE_ZONE("poll"); contextPollEvents(); }
+        { PROFILE_ZONE("textures"); updateTextures(TEXTURE_BUDGET_MS); }
+        bounds2D view = visibleBounds(MVP, CULL_MARGIN);
+        bool sceneLoaded;
+        { PROFILE_ZONE("scene"); sceneLoaded = streamSceneFile(&scene, view, SCENE_BUDGET_MS); }
+        { PROFILE_ZONE("clear"); beginScaledFrame(); glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); }
+        updateFrameUniforms();
+
+        // Get the uniform locations once a program has linked. Locations only
+        // change when a program is relinked, uploading new vertex data does
+        // not affect them.
+        if (!textureUniformsReady && programReady(tex.shader)){
+            getUniform(&tex);
+            textureUniformsReady = true;
+        }
+        if (!colorUniformsReady && programReady(dot.shader)){
+            getUniform(&dot);
+            getUniform(&tri);
+            getUniform(&line);
+            colorUniformsReady = true;
+        }
+
+        // Objects outside the view are skipped. A scene this small tests each
+        // one, large ones keep a cullGrid.
+        if (textureUniformsReady && boundsOverlap(tex.bounds, view)){
+            PROFILE_ZONE("drawElements tex"); drawElements(&tex);
+        }
+
+        if (colorUniformsReady && !sceneName){
+            if (boundsOverlap(dot.bounds, view)){ PROFILE_ZONE("drawArray dot"); drawArray(&dot); }
+            if (boundsOverlap(tri.bounds, view)){ PROFILE_ZONE("drawArray tri"); drawArray(&tri); }
+            if (boundsOverlap(line.bounds, view)){ PROFILE_ZONE("drawArray line"); drawArray(&line); }
+        }
+        { PROFILE_ZONE("drawSceneFile"); drawSceneFile(&scene, view); }
+        { PROFILE_ZONE("upscale"); endScaledFrame(); }
+
+        { PROFILE_ZONE("capture"); captureFrame(); }
+        { PROFILE_ZONE("swap"); contextSwapBuffers(); }
+        profilerEndFrame();
+        loading = !textureUniformsReady || !colorUniformsReady || !textureReady(tex.texture) || !sceneLoaded;
+    }
+    profilerWrite();
+    if (profilerEnabled()){ // stdout may carry frames
+        printStateStatistics(cerr);
+        printProgramCacheStatistics(cerr);
+        printTextureCacheStatistics(cerr);
+        printPoolStatistics(cerr);
+        printResolutionStatistics(cerr);
     }
 
     // Clean up
-    glDeleteVertexArrays(1, &VertexArrayID);
-
-    glDeleteBuffers(1, &dot.vertexBuffer);
-    glDeleteBuffers(1, &tri.vertexBuffer);
-    glDeleteBuffers(1, &line.vertexBuffer);
-
-    glDeleteProgram(dot.shader);
-    glDeleteProgram(tri.shader);
-    glDeleteProgram(line.shader);
-
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    finishCapture();
+    finishResolution();
+    stopTextureLoader();
+    closeSceneFile(&scene);
+    stateDeleteTextures(1, &tex.texture);
+    stateDeleteVertexArrays(1, &VertexArrayID);
+    deleteArray(&tex);
+    deleteArray(&dot);
+    deleteArray(&tri);
+    deleteArray(&line);
+    releasePool();
+    deleteFrameUniforms();
+    if (profilerEnabled()) printLiveObjects(cerr); // Anything left has leaked
+
+    releaseProgram(dot.shader);
+    releaseProgram(tri.shader);
+    releaseProgram(line.shader);
+    releaseProgram(tex.shader);
+
+    destroyContext();
 
     return 0;
 }
@@ -0,0 +1,109 @@
+#ifdef WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#include <algorithm>
+
+#include "MappedFile.h"
+
+using namespace std;
+
+#ifdef WIN32
+
+bool mapFile(const char *file_name, mappedFile *mapped){
+    mapped->data = NULL;
+    mapped->size = 0;
+    mapped->mapping = NULL;
+    mapped->file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL, NULL);
+    if (mapped->file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(mapped->file, &size) && size.QuadPart > 0){
+        mapped->mapping = CreateFileMappingA(mapped->file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapped->mapping)
+            mapped->data = (const unsigned char*)MapViewOfFile(mapped->mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+    if (!mapped->data){
+        unmapFile(mapped);
+        return false;
+    }
+    mapped->size = (size_t)size.QuadPart;
+    return true;
+}
+
+void unmapFile(mappedFile *mapped){
+    if (mapped->data) UnmapViewOfFile(mapped->data);
+    if (mapped->mapping) CloseHandle(mapped->mapping);
+    if (mapped->file != INVALID_HANDLE_VALUE) CloseHandle(mapped->file);
+    mapped->data = NULL;
+    mapped->size = 0;
+    mapped->mapping = NULL;
+    mapped->file = INVALID_HANDLE_VALUE;
+}
+
+void prefetchMappedRange(mappedFile const* mapped, size_t offset, size_t size){
+    // PrefetchVirtualMemory needs Windows 8, the first touch reads it in anyway
+}
+
+void releaseMappedRange(mappedFile const* mapped, size_t offset, size_t size){
+    // Unlocking pages that are not locked takes them out of the working set
+    if (offset < mapped->size)
+        VirtualUnlock((void*)(mapped->data + offset), min(size, mapped->size - offset));
+}
+
+#else
+
+bool mapFile(const char *file_name, mappedFile *mapped){
+    mapped->data = NULL;
+    mapped->size = 0;
+    mapped->file = open(file_name, O_RDONLY);
+    if (mapped->file < 0) return false;
+
+    struct stat info;
+    if (fstat(mapped->file, &info) == 0 && info.st_size > 0){
+        void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, mapped->file, 0);
+        if (data != MAP_FAILED){
+            mapped->data = (const unsigned char*)data;
+            mapped->size = info.st_size;
+        }
+    }
+    if (!mapped->data){
+        unmapFile(mapped);
+        return false;
+    }
+    return true;
+}
+
+void unmapFile(mappedFile *mapped){
+    if (mapped->data) munmap((void*)mapped->data, mapped->size);
+    if (mapped->file >= 0) close(mapped->file);
+    mapped->data = NULL;
+    mapped->size = 0;
+    mapped->file = -1;
+}
+
+// Grows the range out to whole pages, as madvise wants
+static void adviseRange(mappedFile const* mapped, size_t offset, size_t size, int advice){
+    if (offset >= mapped->size) return;
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t begin = offset / page * page;
+    size_t end = min(offset + size, mapped->size);
+    madvise((void*)(mapped->data + begin), end - begin, advice);
+}
+
+void prefetchMappedRange(mappedFile const* mapped, size_t offset, size_t size){
+    adviseRange(mapped, offset, size, MADV_WILLNEED);
+}
+
+void releaseMappedRange(mappedFile const* mapped, size_t offset, size_t size){
+    adviseRange(mapped, offset, size, MADV_DONTNEED);
+}
+
+#endif
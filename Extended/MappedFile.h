@@ -0,0 +1,29 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+
+// A whole file mapped read-only into memory. Pages are read in by the OS on
+// first touch, so nothing is copied until it is used.
+struct mappedFile {
+    const unsigned char *data;
+    size_t size;
+#ifdef WIN32
+    void *file;
+    void *mapping;
+#else
+    int file;
+#endif
+};
+
+// False if the file cannot be opened or is empty
+bool mapFile(const char *file_name, mappedFile *mapped);
+void unmapFile(mappedFile *mapped);
+
+// Hints about [offset, offset + size): prefetch asks the OS to start reading
+// it in, release drops its pages from memory. Released pages are read from
+// the file again if touched, so this bounds what a large file keeps resident.
+void prefetchMappedRange(mappedFile const* mapped, size_t offset, size_t size);
+void releaseMappedRange(mappedFile const* mapped, size_t offset, size_t size);
+
+#endif
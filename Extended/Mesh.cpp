@@ -0,0 +1,171 @@
+#include <GL/glew.h>
+
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+
+#include "Mesh.h"
+
+using namespace std;
+
+struct meshVertex {
+    GLfloat values[MESH_STRIDE];
+
+    bool operator==(meshVertex const& other) const {
+        return memcmp(values, other.values, sizeof(values)) == 0;
+    }
+};
+
+// 64-bit FNV-1a over the bytes of the vertex
+struct meshVertexHash {
+    size_t operator()(meshVertex const& vertex) const {
+        const unsigned char *bytes = (const unsigned char*)vertex.values;
+        unsigned long long hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < sizeof(vertex.values); i++){
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+        return (size_t)hash;
+    }
+};
+
+void weldMesh(struct indexedMesh *mesh, geometryArena *arena, const GLfloat *positions,
+              const GLfloat *uvs, GLuint vertexCount){
+    mesh->vertexArray = arenaFloats(arena, vertexCount * MESH_STRIDE);
+    mesh->indexArray = (GLuint*)arenaAlloc(arena, vertexCount * sizeof(GLuint));
+    mesh->vertexCount = 0;
+    mesh->indexCount = vertexCount;
+
+    unordered_map<meshVertex, GLuint, meshVertexHash> welded;
+    welded.reserve(vertexCount);
+    for (GLuint i = 0; i < vertexCount; i++){
+        // Adding 0 turns -0 into 0, so the two compare equal bitwise
+        meshVertex vertex = {{positions[i * 3] + 0.0f, positions[i * 3 + 1] + 0.0f,
+                              positions[i * 3 + 2] + 0.0f, uvs[i * 2] + 0.0f, uvs[i * 2 + 1] + 0.0f}};
+
+        unordered_map<meshVertex, GLuint, meshVertexHash>::iterator it = welded.find(vertex);
+        if (it == welded.end()){
+            it = welded.insert(make_pair(vertex, mesh->vertexCount)).first;
+            copy(vertex.values, vertex.values + MESH_STRIDE,
+                 mesh->vertexArray + mesh->vertexCount * MESH_STRIDE);
+            mesh->vertexCount++;
+        }
+        mesh->indexArray[i] = it->second;
+    }
+}
+
+// Tipsify's working state. Cache time stamps stand in for a simulated cache:
+// a vertex is still cached while time - stamp <= VERTEX_CACHE_SIZE.
+struct tipsifyState {
+    vector<GLuint> live;       // Triangles not yet emitted, per vertex
+    vector<int> stamps;
+    vector<GLuint> deadEnds;   // Recently used vertices, to restart from
+    vector<GLuint> candidates; // Vertices of the last fan
+    int time;
+    GLuint cursor;             // Lowest vertex that may still be live
+};
+
+// The candidate that stays cached while its remaining triangles are
+// emitted, preferring the oldest one. Falls back to a recent vertex, then
+// to any vertex with triangles left, and returns -1 when all are done.
+static long nextFanningVertex(tipsifyState *state){
+    long best = -1;
+    int bestPriority = -1;
+    for (size_t i = 0; i < state->candidates.size(); i++){
+        GLuint v = state->candidates[i];
+        if (state->live[v] == 0) continue;
+        int age = state->time - state->stamps[v];
+        int priority = age + 2 * (int)state->live[v] <= VERTEX_CACHE_SIZE ? age : 0;
+        if (priority > bestPriority){
+            bestPriority = priority;
+            best = v;
+        }
+    }
+    if (best >= 0) return best;
+
+    while (!state->deadEnds.empty()){
+        GLuint v = state->deadEnds.back();
+        state->deadEnds.pop_back();
+        if (state->live[v] > 0) return v;
+    }
+    for (; state->cursor < state->live.size(); state->cursor++)
+        if (state->live[state->cursor] > 0) return state->cursor;
+    return -1;
+}
+
+void optimizeMesh(struct indexedMesh *mesh){
+    GLuint vertexCount = mesh->vertexCount;
+    GLuint indexCount = mesh->indexCount;
+    const GLuint *indices = mesh->indexArray;
+
+    tipsifyState state;
+    state.live.assign(vertexCount, 0);
+    state.stamps.assign(vertexCount, 0);
+    state.time = VERTEX_CACHE_SIZE + 1;
+    state.cursor = 0;
+
+    // Triangles around each vertex, packed into one list
+    for (GLuint i = 0; i < indexCount; i++) state.live[indices[i]]++;
+    vector<GLuint> first(vertexCount + 1, 0);
+    for (GLuint v = 0; v < vertexCount; v++) first[v + 1] = first[v] + state.live[v];
+    vector<GLuint> adjacency(indexCount);
+    vector<GLuint> filled(first.begin(), first.end() - 1);
+    for (GLuint i = 0; i < indexCount; i++) adjacency[filled[indices[i]]++] = i / 3;
+
+    // Emit every remaining triangle around the fanning vertex, then move on
+    vector<bool> emitted(indexCount / 3, false);
+    vector<GLuint> ordered;
+    ordered.reserve(indexCount);
+    for (long fanning = nextFanningVertex(&state); fanning >= 0; fanning = nextFanningVertex(&state)){
+        state.candidates.clear();
+        for (GLuint a = first[fanning]; a < first[fanning + 1]; a++){
+            GLuint t = adjacency[a];
+            if (emitted[t]) continue;
+            emitted[t] = true;
+
+            for (int k = 0; k < 3; k++){
+                GLuint v = indices[t * 3 + k];
+                ordered.push_back(v);
+                state.deadEnds.push_back(v);
+                state.candidates.push_back(v);
+                state.live[v]--;
+                if (state.time - state.stamps[v] > VERTEX_CACHE_SIZE) state.stamps[v] = state.time++;
+            }
+        }
+    }
+
+    // Vertices numbered by first use, so the data is read front to back
+    const GLuint UNUSED = 0xFFFFFFFF;
+    vector<GLuint> remap(vertexCount, UNUSED);
+    GLuint used = 0;
+    for (GLuint i = 0; i < indexCount; i++){
+        GLuint &v = ordered[i];
+        if (remap[v] == UNUSED) remap[v] = used++;
+        v = remap[v];
+    }
+
+    vector<GLfloat> vertices(mesh->vertexArray, mesh->vertexArray + vertexCount * MESH_STRIDE);
+    for (GLuint v = 0; v < vertexCount; v++){
+        if (remap[v] == UNUSED) continue;
+        copy(&vertices[v * MESH_STRIDE], &vertices[v * MESH_STRIDE] + MESH_STRIDE,
+             mesh->vertexArray + remap[v] * MESH_STRIDE);
+    }
+    copy(ordered.begin(), ordered.end(), mesh->indexArray);
+    mesh->vertexCount = used;
+}
+
+double vertexCacheMissRatio(const GLuint *indices, GLuint indexCount, int cacheSize){
+    if (indexCount < 3) return 0.0;
+
+    deque<GLuint> cache;
+    unsigned long misses = 0;
+    for (GLuint i = 0; i < indexCount; i++){
+        if (find(cache.begin(), cache.end(), indices[i]) != cache.end()) continue;
+        misses++;
+        cache.push_back(indices[i]);
+        if ((int)cache.size() > cacheSize) cache.pop_front();
+    }
+    return (double)misses / (indexCount / 3);
+}
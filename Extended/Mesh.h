@@ -0,0 +1,29 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <GL/glew.h>
+
+#include "Arena.h"
+#include "Render.h"
+
+// Post-transform cache size optimizeMesh plans for. Real caches range from
+// about 12 to 32 entries, and the order holds up across that range.
+static const int VERTEX_CACHE_SIZE = 16;
+
+// Builds an indexed mesh out of vertexCount unindexed triangle vertices,
+// storing each distinct position+UV once. The vertex and index arrays come
+// from the arena, like every other object's geometry.
+void weldMesh(struct indexedMesh *mesh, geometryArena *arena, const GLfloat *positions,
+              const GLfloat *uvs, GLuint vertexCount);
+
+// Reorders the triangles for the post-transform vertex cache (Tipsify,
+// Sander et al. 2007), then renumbers the vertices in the order they are
+// first used, so vertex fetches walk memory forwards
+void optimizeMesh(struct indexedMesh *mesh);
+
+// Average cache miss ratio: vertex shader runs per triangle with a FIFO
+// cache of cacheSize entries. 3.0 means no reuse at all, and a regular grid
+// cannot get below 0.5.
+double vertexCacheMissRatio(const GLuint *indices, GLuint indexCount, int cacheSize);
+
+#endif
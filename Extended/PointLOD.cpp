@@ -0,0 +1,219 @@
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <vector>
+#include <queue>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+
+#include "PointLOD.h"
+#include "Render.h"
+#include "State.h"
+
+using namespace std;
+
+// Trees that hold no more points than this in a node stop splitting
+static const GLuint LOD_LEAF_POINTS = LOD_GRID * LOD_GRID / 4;
+
+struct pointBuild {
+    const GLfloat *points;
+    vector<GLuint> order; // Point indices, rearranged node by node
+    vector<char> occupied; // The sample grid of the node being built
+};
+
+static GLint gridCell(GLfloat value, GLfloat origin, GLfloat cellSize){
+    return min(LOD_GRID - 1, max(0, (GLint)((value - origin) / cellSize)));
+}
+
+// Takes a sample of order[begin, end) for a new node and splits the rest
+// among its children. Returns the node's index.
+static GLint buildNode(pointCloud *cloud, pointBuild *build, GLuint begin, GLuint end,
+                       bounds2D bounds, GLint level, GLint parent){
+    GLint index = cloud->nodes.size();
+    cloud->nodes.push_back(pointNode());
+
+    // The first point in each cell stays here, the rest move to the back
+    GLuint taken = end;
+    if (end - begin > LOD_LEAF_POINTS && level < LOD_MAX_DEPTH){
+        GLfloat cellSize = (bounds.maxX - bounds.minX) / LOD_GRID;
+        fill(build->occupied.begin(), build->occupied.end(), 0);
+        taken = begin;
+        for (GLuint i = begin; i < end; i++){
+            const GLfloat *point = build->points + (size_t)build->order[i] * 3;
+            char &cell = build->occupied[gridCell(point[1], bounds.minY, cellSize) * LOD_GRID +
+                                         gridCell(point[0], bounds.minX, cellSize)];
+            if (cell) continue;
+            cell = 1;
+            swap(build->order[i], build->order[taken++]);
+        }
+    }
+
+    pointNode node;
+    node.bounds = bounds;
+    node.first = begin;
+    node.count = taken - begin;
+    node.parent = parent;
+    node.level = level;
+    fill(node.children, node.children + 4, -1);
+
+    // Quadrants, split on x and then on y
+    GLfloat midX = (bounds.minX + bounds.maxX) / 2.0f, midY = (bounds.minY + bounds.maxY) / 2.0f;
+    const GLfloat *points = build->points;
+    GLuint *first = build->order.data();
+    GLuint splitX = partition(first + taken, first + end,
+                              [points, midX](GLuint p){ return points[(size_t)p * 3] < midX; }) - first;
+    GLuint splits[5] = {taken, 0, splitX, 0, end};
+    for (int half = 0; half < 2; half++){
+        splits[half * 2 + 1] = partition(first + splits[half * 2], first + splits[half * 2 + 2],
+                                         [points, midY](GLuint p){ return points[(size_t)p * 3 + 1] < midY; }) - first;
+    }
+    for (int quadrant = 0; quadrant < 4; quadrant++){
+        if (splits[quadrant] == splits[quadrant + 1]) continue;
+        bounds2D child = bounds;
+        if (quadrant & 1) child.minY = midY; else child.maxY = midY;
+        if (quadrant & 2) child.minX = midX; else child.maxX = midX;
+        node.children[quadrant] = buildNode(cloud, build, splits[quadrant], splits[quadrant + 1],
+                                            child, level + 1, index);
+    }
+
+    cloud->nodes[index] = node;
+    return index;
+}
+
+void buildPointCloud(struct pointCloud *cloud, const GLfloat *points, GLuint count){
+    cloud->nodes.clear();
+    cloud->selected.clear();
+    cloud->runs.clear();
+    cloud->selectedPoints = 0;
+    cloud->bounds = computeBounds(points, count, 3);
+    if (count == 0) return;
+
+    // A square root, so every level halves the spacing on both axes
+    bounds2D root = cloud->bounds;
+    GLfloat size = max(max(root.maxX - root.minX, root.maxY - root.minY), 1.0f);
+    root.maxX = root.minX + size;
+    root.maxY = root.minY + size;
+
+    pointBuild build;
+    build.points = points;
+    build.order.resize(count);
+    for (GLuint i = 0; i < count; i++) build.order[i] = i;
+    build.occupied.resize(LOD_GRID * LOD_GRID);
+    buildNode(cloud, &build, 0, count, root, 0, -1);
+    cloud->finest.resize(cloud->nodes.size());
+
+    vector<GLfloat> ordered((size_t)count * 3);
+    for (GLuint i = 0; i < count; i++)
+        copy(points + (size_t)build.order[i] * 3, points + (size_t)build.order[i] * 3 + 3, &ordered[(size_t)i * 3]);
+
+    stateBindBuffer(GL_ARRAY_BUFFER, cloud->vertexBuffer);
+    if (cloud->layout){
+        unique_ptr<char[]> packed(new char[(size_t)count * cloud->layout->stride]);
+        const GLfloat *sources[MAX_LAYOUT_ATTRIBUTES] = {ordered.data()};
+        int strides[MAX_LAYOUT_ATTRIBUTES] = {3};
+        packVertices(*cloud->layout, packed.get(), sources, strides, count);
+        stateBufferData(GL_ARRAY_BUFFER, (size_t)count * cloud->layout->stride, packed.get(), GL_STATIC_DRAW);
+    } else {
+        stateBufferData(GL_ARRAY_BUFFER, ordered.size() * sizeof(GLfloat), ordered.data(), GL_STATIC_DRAW);
+    }
+
+    if (cloud->vertexArrayID == 0) glGenVertexArrays(1, &cloud->vertexArrayID);
+    stateBindVertexArray(cloud->vertexArrayID);
+    setVertexAttributes(cloud->layout ? *cloud->layout : positionLayout, 0);
+}
+
+static bool runOrder(pointRun const& a, pointRun const& b){
+    return a.first < b.first;
+}
+
+void selectPoints(struct pointCloud *cloud, glm::mat4 const& mvp, bounds2D const& view, GLuint budget){
+    cloud->selected.clear();
+    cloud->runs.clear();
+    cloud->selectedPoints = 0;
+    if (cloud->nodes.empty() || !boundsOverlap(cloud->nodes[0].bounds, view)) return;
+
+    // Orthographic, so one scale covers the whole view
+    GLfloat pixelsPerUnit = fabs(mvp[0][0]) * width / 2.0f;
+    GLfloat rootSpacing = (cloud->nodes[0].bounds.maxX - cloud->nodes[0].bounds.minX) / LOD_GRID * pixelsPerUnit;
+
+    // Widest nodes on screen first, so detail spreads evenly over the view.
+    // Stopping at the first node over budget keeps coarser ones from being
+    // skipped for finer ones. A node's visible children are picked all
+    // together or not at all: a node left unrefined samples its whole square
+    // at its own spacing, but a refined one only covers its square together
+    // with every child.
+    cloud->selected.push_back(0);
+    cloud->selectedPoints = cloud->nodes[0].count;
+    cloud->finest[0] = 0;
+    priority_queue<pair<GLfloat, GLint> > open;
+    open.push(make_pair(rootSpacing, 0));
+    while (!open.empty()){
+        GLfloat spacing = open.top().first;
+        GLint index = open.top().second;
+        open.pop();
+        if (spacing <= LOD_MIN_SPACING) continue;
+
+        pointNode const& node = cloud->nodes[index];
+        GLint visible[4];
+        int visibleCount = 0;
+        GLuint points = 0;
+        for (int c = 0; c < 4; c++){
+            GLint child = node.children[c];
+            if (child < 0 || !boundsOverlap(cloud->nodes[child].bounds, view)) continue;
+            visible[visibleCount++] = child;
+            points += cloud->nodes[child].count;
+        }
+        if (cloud->selectedPoints + points > budget) break;
+
+        for (int c = 0; c < visibleCount; c++){
+            cloud->selected.push_back(visible[c]);
+            cloud->selectedPoints += cloud->nodes[visible[c]].count;
+            cloud->finest[visible[c]] = cloud->nodes[visible[c]].level;
+            open.push(make_pair(spacing / 2.0f, visible[c]));
+        }
+    }
+
+    // Children come after their parents, so walking back carries the finest
+    // level up to every ancestor
+    for (size_t i = cloud->selected.size(); i-- > 1;){
+        GLint index = cloud->selected[i];
+        GLint parent = cloud->nodes[index].parent;
+        cloud->finest[parent] = max(cloud->finest[parent], cloud->finest[index]);
+    }
+
+    for (size_t i = 0; i < cloud->selected.size(); i++){
+        pointNode const& node = cloud->nodes[cloud->selected[i]];
+        GLfloat size = rootSpacing / (GLfloat)(1 << cloud->finest[cloud->selected[i]]);
+        pointRun run = {node.first, node.count, min(max(size, 1.0f), LOD_MAX_POINT_SIZE)};
+        cloud->runs.push_back(run);
+    }
+
+    // A parent's points are followed by its first child's, so many runs join
+    sort(cloud->runs.begin(), cloud->runs.end(), runOrder);
+    size_t merged = 0;
+    for (size_t i = 1; i < cloud->runs.size(); i++){
+        pointRun &last = cloud->runs[merged];
+        pointRun const& run = cloud->runs[i];
+        if (last.first + last.count == run.first && last.pointSize == run.pointSize) last.count += run.count;
+        else cloud->runs[++merged] = run;
+    }
+    if (!cloud->runs.empty()) cloud->runs.resize(merged + 1);
+}
+
+void drawPointCloud(struct pointCloud *cloud){
+    if (cloud->runs.empty()) return;
+    stateUseProgram(cloud->shader);
+    stateVertexAttrib3fv(2, glm::value_ptr(cloud->colorVec));
+
+    stateBindVertexArray(cloud->vertexArrayID);
+    for (size_t i = 0; i < cloud->runs.size(); i++){
+        stateUniform1f(cloud->shader, cloud->pointSizeID, cloud->runs[i].pointSize);
+        glDrawArrays(GL_POINTS, cloud->runs[i].first, cloud->runs[i].count);
+    }
+}
+
+void getUniform(struct pointCloud *cloud){
+    cloud->pointSizeID = glGetUniformLocation(cloud->shader, "uPointSize");
+}
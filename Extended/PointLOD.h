@@ -0,0 +1,71 @@
+#ifndef POINTLOD_H
+#define POINTLOD_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Cull.h"
+#include "VertexLayout.h"
+
+// Level of detail for large GL_POINTS sets. A quadtree is built over the
+// points once. Each node keeps a spatially even sample of the points in its
+// square, at most one per cell of an LOD_GRID x LOD_GRID grid, and hands the
+// rest to its children. Drawing a node and all its ancestors therefore shows
+// every region at that node's density. Each frame selectPoints walks down
+// from the root, coarsest nodes on screen first, until the point budget is
+// spent or the points are a pixel apart. Frame cost then depends on the
+// budget, not on the size of the set. Draw with pointLOD.vert.
+
+static const int LOD_GRID = 64;
+static const int LOD_MAX_DEPTH = 20;
+static const GLfloat LOD_MIN_SPACING = 1.0f; // Pixels, nodes this dense are not refined
+static const GLfloat LOD_MAX_POINT_SIZE = 20.0f; // As colorVertex.vert draws points
+
+struct pointNode {
+    bounds2D bounds; // Square
+    GLuint first, count; // Its points in the cloud's buffer
+    GLint children[4]; // -1 where there are no points
+    GLint parent;
+    GLint level;
+};
+
+// Selected points that are contiguous in the buffer and share a size
+struct pointRun {
+    GLuint first, count;
+    GLfloat pointSize;
+};
+
+struct pointCloud {
+    GLuint shader;
+    glm::vec3 colorVec;
+    const vertexLayout *layout; // NULL for positionLayout
+    GLint pointSizeID;
+    GLuint vertexBuffer;
+    GLuint vertexArrayID;
+    std::vector<pointNode> nodes; // The root first
+    std::vector<GLint> selected; // Nodes picked by selectPoints, parents before children
+    std::vector<GLint> finest; // Per node, the deepest level selected beneath it
+    std::vector<pointRun> runs; // What drawPointCloud draws, one glDrawArrays each
+    GLuint selectedPoints;
+    bounds2D bounds;
+};
+
+// Builds the tree over count xyz points and uploads them in node order into
+// vertexBuffer, which the caller has generated. points can be freed after.
+void buildPointCloud(struct pointCloud *cloud, const GLfloat *points, GLuint count);
+
+// Picks the nodes to draw with mvp, drawing at most about budget points from
+// those that overlap view. A node is only refined while its points are more
+// than LOD_MIN_SPACING pixels apart, and then into all of its visible
+// children or none of them, even when the budget runs out partway through a
+// level. Each node's points are sized to the spacing of the finest level
+// picked beneath it. Every node left unrefined samples its whole square at
+// its own spacing, so together they cover the gaps.
+void selectPoints(struct pointCloud *cloud, glm::mat4 const& mvp, bounds2D const& view, GLuint budget);
+
+void drawPointCloud(struct pointCloud *cloud);
+void getUniform(struct pointCloud *cloud);
+
+#endif
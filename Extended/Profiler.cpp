@@ -0,0 +1,283 @@
+#ifdef WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#endif
+
+#include <GL/glew.h>
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <assert.h>
+
+#include "Profiler.h"
+
+using namespace std;
+
+typedef chrono::steady_clock profileClock;
+
+// Queries are read back this many frames after they were issued
+static const int QUERY_RING_SIZE = 4;
+static const long DEFAULT_FRAME_LIMIT = 10000;
+
+struct frameRecord {
+    double cpuFrame;
+    vector<double> cpu;  // Summed per zone, in milliseconds
+    vector<double> gpu;  // Summed per zone, negative until resolved
+    bool gpuResolved;
+};
+
+struct querySlot {
+    long frame;
+    vector<GLuint> queries;
+    vector<int> zones;
+    size_t used;
+};
+
+struct openZone {
+    int zone;
+    profileClock::time_point start;
+    bool ownsQuery;
+};
+
+static bool enabled = false;
+static string outputPrefix;
+static vector<string> zoneNames;
+static vector<frameRecord> frames; // A ring of the last frameLimit frames
+static long frameLimit = DEFAULT_FRAME_LIMIT;
+static long frameCount = 0; // Every frame begun, frame f is kept in frames[f % frameLimit]
+static querySlot queryRing[QUERY_RING_SIZE];
+static vector<openZone> openZones;
+static profileClock::time_point frameStart;
+static bool queryActive = false; // GL_TIME_ELAPSED queries cannot nest
+
+void parseProfilerOptions(int argc, char *argv[]){
+    for (int i = 1; i < argc - 1; i++){
+        if (string(argv[i]) == "--profile"){
+            enabled = true;
+            outputPrefix = argv[i + 1];
+        }
+        else if (string(argv[i]) == "--profile-frames")
+            frameLimit = max((long)QUERY_RING_SIZE, atol(argv[i + 1])); // At least the queries in flight
+    }
+}
+
+bool profilerEnabled(){
+    return enabled;
+}
+
+int profilerZone(const char* name){
+    for (size_t i = 0; i < zoneNames.size(); i++)
+        if (zoneNames[i] == name) return i;
+    zoneNames.push_back(name);
+    return zoneNames.size() - 1;
+}
+
+static double elapsedMs(profileClock::time_point start){
+    return chrono::duration<double, milli>(profileClock::now() - start).count();
+}
+
+static frameRecord *frameAt(long frame){
+    return &frames[frame % frameLimit];
+}
+
+static void growFrame(frameRecord *frame){
+    frame->cpu.resize(zoneNames.size(), 0.0);
+    frame->gpu.resize(zoneNames.size(), -1.0);
+}
+
+// Collects the queries of one ring slot. With wait set the results are
+// fetched even when not available yet, otherwise they are dropped.
+static void resolveSlot(querySlot *slot, bool wait){
+    if (slot->frame < 0) return;
+    frameRecord *frame = frameAt(slot->frame);
+    growFrame(frame);
+
+    bool complete = true;
+    for (size_t i = 0; i < slot->used; i++){
+        GLint available = GL_TRUE;
+        if (!wait) glGetQueryObjectiv(slot->queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available){
+            complete = false;
+            continue;
+        }
+
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(slot->queries[i], GL_QUERY_RESULT, &ns);
+        int zone = slot->zones[i];
+        if (frame->gpu[zone] < 0.0) frame->gpu[zone] = 0.0;
+        frame->gpu[zone] += ns / 1.0e6;
+    }
+
+    frame->gpuResolved = complete;
+    slot->frame = -1;
+    slot->used = 0;
+}
+
+void profilerBeginFrame(){
+    if (!enabled) return;
+
+    if (frameCount == 0)
+        for (int i = 0; i < QUERY_RING_SIZE; i++) queryRing[i].frame = -1;
+
+    long index = frameCount++;
+    querySlot *slot = &queryRing[index % QUERY_RING_SIZE];
+    resolveSlot(slot, false);
+    slot->frame = index;
+
+    // Past frameLimit the oldest record is reused
+    frameRecord frame = {0.0, vector<double>(), vector<double>(), false};
+    if ((long)frames.size() < frameLimit) frames.push_back(frame);
+    else *frameAt(index) = frame;
+    growFrame(frameAt(index));
+    frameStart = profileClock::now();
+}
+
+void profilerEndFrame(){
+    if (!enabled || frameCount == 0) return;
+    frameAt(frameCount - 1)->cpuFrame = elapsedMs(frameStart);
+}
+
+void profilerBegin(int zone){
+    if (!enabled || frameCount == 0) return;
+
+    openZone open = {zone, profileClock::now(), false};
+    if (!queryActive){
+        querySlot *slot = &queryRing[(frameCount - 1) % QUERY_RING_SIZE];
+        if (slot->used == slot->queries.size()){
+            GLuint query;
+            glGenQueries(1, &query);
+            slot->queries.push_back(query);
+            slot->zones.push_back(zone);
+        }
+        slot->zones[slot->used] = zone;
+        glBeginQuery(GL_TIME_ELAPSED, slot->queries[slot->used++]);
+        open.ownsQuery = queryActive = true;
+    }
+    openZones.push_back(open);
+}
+
+void profilerEnd(int zone){
+    if (!enabled || openZones.empty()) return;
+
+    openZone open = openZones.back();
+    openZones.pop_back();
+    assert(open.zone == zone && "Profiler zones must nest");
+
+    if (open.ownsQuery){
+        glEndQuery(GL_TIME_ELAPSED);
+        queryActive = false;
+    }
+
+    frameRecord *frame = frameAt(frameCount - 1);
+    growFrame(frame);
+    frame->cpu[zone] += elapsedMs(open.start);
+}
+
+struct percentiles {
+    size_t count;
+    double mean, p50, p95, p99, max;
+};
+
+static percentiles computePercentiles(vector<double> values){
+    percentiles result = {0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    values.erase(remove_if(values.begin(), values.end(),
+                           [](double v){ return v < 0.0; }), values.end());
+    if (values.empty()) return result;
+
+    sort(values.begin(), values.end());
+    double sum = 0.0;
+    for (double v : values) sum += v;
+
+    // Nearest-rank percentiles
+    size_t n = values.size();
+    result.count = n;
+    result.mean = sum / n;
+    result.p50 = values[min(n - 1, (size_t)(0.50 * n))];
+    result.p95 = values[min(n - 1, (size_t)(0.95 * n))];
+    result.p99 = values[min(n - 1, (size_t)(0.99 * n))];
+    result.max = values[n - 1];
+    return result;
+}
+
+static void writeJSONStats(ofstream& out, vector<double> const& values){
+    percentiles p = computePercentiles(values);
+    out << "{\"count\": " << p.count << ", \"mean\": " << p.mean
+        << ", \"p50\": " << p.p50 << ", \"p95\": " << p.p95
+        << ", \"p99\": " << p.p99 << ", \"max\": " << p.max << "}";
+}
+
+static double frameGPU(frameRecord const& frame){
+    if (!frame.gpuResolved) return -1.0;
+    double sum = 0.0;
+    for (double v : frame.gpu) if (v > 0.0) sum += v;
+    return sum;
+}
+
+void profilerWrite(){
+    if (!enabled) return;
+    for (int i = 0; i < QUERY_RING_SIZE; i++) resolveSlot(&queryRing[i], true);
+    for (size_t f = 0; f < frames.size(); f++) growFrame(&frames[f]);
+
+    // The kept frames, oldest first
+    long first = frameCount - frames.size();
+    vector<frameRecord*> kept;
+    for (long f = first; f < frameCount; f++) kept.push_back(frameAt(f));
+
+    // Per-frame rows, unresolved GPU times are left empty
+    ofstream csv((outputPrefix + ".csv").c_str());
+    csv << "frame,cpu_frame_ms,gpu_frame_ms";
+    for (size_t z = 0; z < zoneNames.size(); z++)
+        csv << "," << zoneNames[z] << "_cpu_ms," << zoneNames[z] << "_gpu_ms";
+    csv << "\n";
+    for (size_t f = 0; f < kept.size(); f++){
+        csv << first + f << "," << kept[f]->cpuFrame << ",";
+        if (frameGPU(*kept[f]) >= 0.0) csv << frameGPU(*kept[f]);
+        for (size_t z = 0; z < zoneNames.size(); z++){
+            csv << "," << kept[f]->cpu[z] << ",";
+            if (kept[f]->gpu[z] >= 0.0) csv << kept[f]->gpu[z];
+        }
+        csv << "\n";
+    }
+
+    vector<double> cpuFrames, gpuFrames;
+    for (size_t f = 0; f < kept.size(); f++){
+        cpuFrames.push_back(kept[f]->cpuFrame);
+        gpuFrames.push_back(frameGPU(*kept[f]));
+    }
+
+    ofstream json((outputPrefix + ".json").c_str());
+    json << "{\n  \"frames\": " << kept.size() << ",\n  \"dropped_frames\": " << first
+         << ",\n  \"frame_cpu_ms\": ";
+    writeJSONStats(json, cpuFrames);
+    json << ",\n  \"frame_gpu_ms\": ";
+    writeJSONStats(json, gpuFrames);
+    json << ",\n  \"zones\": [";
+    for (size_t z = 0; z < zoneNames.size(); z++){
+        vector<double> cpu, gpu;
+        for (size_t f = 0; f < kept.size(); f++){
+            cpu.push_back(kept[f]->cpu[z]);
+            gpu.push_back(kept[f]->gpu[z]);
+        }
+        json << (z ? ",\n" : "\n") << "    {\"name\": \"" << zoneNames[z] << "\", \"cpu_ms\": ";
+        writeJSONStats(json, cpu);
+        json << ", \"gpu_ms\": ";
+        writeJSONStats(json, gpu);
+        json << "}";
+    }
+    json << "\n  ]\n}\n";
+
+    percentiles cpu = computePercentiles(cpuFrames);
+    cerr << "Profile: " << kept.size() << " frames";
+    if (first > 0) cerr << " (the last of " << frameCount << ")";
+    cerr << ", cpu p50 " << cpu.p50 << " ms, p99 " << cpu.p99 << " ms, written to "
+         << outputPrefix << ".json/.csv" << endl;
+
+    for (int i = 0; i < QUERY_RING_SIZE; i++)
+        if (!queryRing[i].queries.empty())
+            glDeleteQueries(queryRing[i].queries.size(), queryRing[i].queries.data());
+}
@@ -0,0 +1,42 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <GL/glew.h>
+
+// Per-frame CPU/GPU timing. CPU time comes from a steady clock, GPU time
+// from GL_TIME_ELAPSED queries that are read back a few frames later, so
+// timing never stalls the pipeline. Enable with --profile PREFIX, which
+// writes PREFIX.json (percentiles) and PREFIX.csv (per frame) on exit.
+// Both cover the last --profile-frames N frames, 10000 by default, so a
+// long run keeps a bounded history.
+
+void parseProfilerOptions(int argc, char *argv[]);
+bool profilerEnabled();
+
+// Registers a named zone, returns the same id for the same name
+int profilerZone(const char* name);
+
+void profilerBeginFrame();
+void profilerEndFrame();
+
+void profilerBegin(int zone);
+void profilerEnd(int zone);
+
+// Resolves outstanding queries and writes the reports. Needs the GL context.
+void profilerWrite();
+
+struct profileScope {
+    int zone;
+    profileScope(int zone) : zone(zone) { profilerBegin(zone); }
+    ~profileScope() { profilerEnd(zone); }
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+// Times the rest of the enclosing scope as the zone `name`
+#define PROFILE_ZONE(name) \
+    static int PROFILE_CONCAT(profileZoneID, __LINE__) = profilerZone(name); \
+    profileScope PROFILE_CONCAT(profileScope, __LINE__)(PROFILE_CONCAT(profileZoneID, __LINE__))
+
+#endif
@@ -0,0 +1,237 @@
+#ifdef WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <direct.h>
+    #define makeDirectory(path) _mkdir(path)
+#else
+    #include <sys/stat.h>
+    #define makeDirectory(path) mkdir(path, 0755)
+#endif
+
+#include <GL/glew.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdio>
+#include <cstring>
+
+#include "ProgramCache.h"
+#include "State.h"
+
+using namespace std;
+
+struct cachedProgram {
+    string vs;
+    string fs;
+    GLuint program;
+    int references;
+};
+
+// Written in front of every binary. The driver hash covers vendor, renderer
+// and version strings, so a driver update invalidates the whole cache.
+struct binaryHeader {
+    char magic[4];
+    GLuint version;
+    GLuint64 driver;
+    GLuint64 source;
+    GLenum format;
+    GLint length;
+};
+
+static const char BINARY_MAGIC[4] = {'G', 'L', 'P', 'B'};
+static const GLuint BINARY_VERSION = 1;
+
+static string cacheDirectory = "shadercache";
+static unordered_map<GLuint64, cachedProgram> programs;
+static programCacheStats stats;
+
+void parseProgramCacheOptions(int argc, char *argv[]){
+    for (int i = 1; i < argc - 1; i++){
+        if (string(argv[i]) == "--shader-cache"){
+            cacheDirectory = argv[i + 1];
+            if (cacheDirectory == "none") cacheDirectory = "";
+        }
+    }
+}
+
+// 64-bit FNV-1a
+static GLuint64 hashBytes(GLuint64 hash, const char *data, size_t length){
+    for (size_t i = 0; i < length; i++){
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static const GLuint64 HASH_SEED = 14695981039346656037ULL;
+
+static GLuint64 sourceHash(string const& vs, string const& fs){
+    GLuint64 hash = hashBytes(HASH_SEED, vs.data(), vs.size());
+    hash = hashBytes(hash, "", 1); // Keeps "ab"+"c" apart from "a"+"bc"
+    return hashBytes(hash, fs.data(), fs.size());
+}
+
+static GLuint64 driverHash(){
+    static GLuint64 hash = 0;
+    if (hash) return hash;
+
+    GLenum names[] = {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION};
+    hash = HASH_SEED;
+    for (int i = 0; i < 4; i++){
+        const char *value = (const char*)glGetString(names[i]);
+        if (value) hash = hashBytes(hash, value, strlen(value) + 1);
+    }
+    return hash;
+}
+
+static bool binariesSupported(){
+    static int supported = -1;
+    if (cacheDirectory.empty()) return false;
+    if (supported >= 0) return supported;
+
+    GLint formats = 0;
+    if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    supported = formats > 0;
+    return supported;
+}
+
+static string binaryPath(GLuint64 hash){
+    ostringstream path;
+    path << cacheDirectory << "/" << hex << setw(16) << setfill('0') << hash << ".bin";
+    return path.str();
+}
+
+static GLuint loadBinary(GLuint64 hash){
+    if (!binariesSupported()) return 0;
+
+    ifstream in(binaryPath(hash).c_str(), ios::binary);
+    if (!in.is_open()) return 0;
+
+    binaryHeader header;
+    in.read((char*)&header, sizeof(header));
+    if (!in || memcmp(header.magic, BINARY_MAGIC, 4) != 0 || header.version != BINARY_VERSION ||
+        header.driver != driverHash() || header.source != hash || header.length <= 0){
+        stats.rejected++;
+        return 0;
+    }
+
+    vector<char> data(header.length);
+    in.read(data.data(), header.length);
+    if (!in){
+        stats.rejected++;
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, data.data(), header.length);
+
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (success == 0){
+        glDeleteProgram(program);
+        stats.rejected++;
+        return 0;
+    }
+    return program;
+}
+
+static void saveBinary(GLuint64 hash, GLuint program){
+    if (!binariesSupported()) return;
+
+    binaryHeader header;
+    memcpy(header.magic, BINARY_MAGIC, 4);
+    header.version = BINARY_VERSION;
+    header.driver = driverHash();
+    header.source = hash;
+    header.length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &header.length);
+    if (header.length <= 0) return;
+
+    vector<char> data(header.length);
+    glGetProgramBinary(program, header.length, NULL, &header.format, data.data());
+
+    // Written aside and renamed, so a crash never leaves half a binary behind
+    makeDirectory(cacheDirectory.c_str());
+    string path = binaryPath(hash);
+    string temporary = path + ".tmp";
+    ofstream out(temporary.c_str(), ios::binary);
+    if (!out.is_open()){
+        cerr << "Could not write shader cache " << temporary << endl;
+        return;
+    }
+    out.write((const char*)&header, sizeof(header));
+    out.write(data.data(), header.length);
+    out.close();
+
+    remove(path.c_str());
+    if (rename(temporary.c_str(), path.c_str()) != 0)
+        cerr << "Could not write shader cache " << path << endl;
+}
+
+GLuint findProgram(string const& vs, string const& fs){
+    GLuint64 hash = sourceHash(vs, fs);
+    unordered_map<GLuint64, cachedProgram>::iterator it = programs.find(hash);
+    if (it != programs.end()){
+        if (it->second.vs != vs || it->second.fs != fs) return 0; // Hash collision
+        it->second.references++;
+        stats.shared++;
+        return it->second.program;
+    }
+
+    GLuint program = loadBinary(hash);
+    if (program){
+        cachedProgram entry = {vs, fs, program, 1};
+        programs[hash] = entry;
+        stats.loaded++;
+    }
+    return program;
+}
+
+void prepareProgram(GLuint program){
+    if (binariesSupported())
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void storeProgram(string const& vs, string const& fs, GLuint program){
+    stats.compiled++;
+
+    // On a collision the program stays out of the cache, and is deleted on release
+    GLuint64 hash = sourceHash(vs, fs);
+    if (programs.count(hash)) return;
+
+    cachedProgram entry = {vs, fs, program, 1};
+    programs[hash] = entry;
+}
+
+void saveProgram(string const& vs, string const& fs, GLuint program){
+    GLuint64 hash = sourceHash(vs, fs);
+    unordered_map<GLuint64, cachedProgram>::iterator it = programs.find(hash);
+    if (it != programs.end() && it->second.program == program) saveBinary(hash, program);
+}
+
+void releaseProgram(GLuint program){
+    unordered_map<GLuint64, cachedProgram>::iterator it;
+    for (it = programs.begin(); it != programs.end(); ++it){
+        if (it->second.program != program) continue;
+        if (--it->second.references > 0) return;
+        programs.erase(it);
+        break;
+    }
+    stateDeletePrograms(1, &program);
+}
+
+programCacheStats const& programCacheStatistics(){
+    return stats;
+}
+
+void printProgramCacheStatistics(ostream &out){
+    out << "Shader programs: " << stats.compiled << " compiled, " << stats.loaded
+        << " loaded from " << (cacheDirectory.empty() ? "(disabled)" : cacheDirectory)
+        << ", " << stats.shared << " shared, " << stats.rejected << " stale binaries" << endl;
+}
@@ -0,0 +1,41 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <GL/glew.h>
+
+#include <ostream>
+#include <string>
+
+// Linked programs keyed on a hash of their vertex+fragment source. Identical
+// sources share one program, and linked binaries are kept on disk with
+// glGetProgramBinary so later runs skip compiling. A binary is only reused
+// when the driver that wrote it is the one running now.
+struct programCacheStats {
+    unsigned long compiled; // Built from source
+    unsigned long loaded;   // Restored from a binary on disk
+    unsigned long shared;   // Handed out again in this run
+    unsigned long rejected; // Binaries that were stale or refused by the driver
+};
+
+// --shader-cache DIR sets the directory (default "shadercache"),
+// --shader-cache none keeps the cache in memory only
+void parseProgramCacheOptions(int argc, char *argv[]);
+
+// Returns the cached program with another reference, or 0 to build it
+GLuint findProgram(std::string const& vs, std::string const& fs);
+
+// Call before glLinkProgram on programs that will be stored
+void prepareProgram(GLuint program);
+
+// Takes the first reference of a program built from vs and fs. It may
+// still be linking; call saveProgram once it has linked to write it out.
+void storeProgram(std::string const& vs, std::string const& fs, GLuint program);
+void saveProgram(std::string const& vs, std::string const& fs, GLuint program);
+
+// Drops a reference, the program is deleted with the last one
+void releaseProgram(GLuint program);
+
+programCacheStats const& programCacheStatistics();
+void printProgramCacheStatistics(std::ostream &out);
+
+#endif
@@ -0,0 +1,522 @@
+#ifdef WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+    #include <GL/glew.h>
+    #include <OpenGL/gl.h>
+    #include <OpenGL/glu.h>
+#else
+    #include <GL/glew.h>
+    #include <GL/gl.h>
+    #include <GL/glu.h>
+#endif
+
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <assert.h>
+
+#include "BufferPool.h"
+#include "Context.h"
+#include "ProgramCache.h"
+#include "Render.h"
+#include "State.h"
+#include "Uniforms.h"
+
+using namespace std;
+
+GLint width = 1024;
+GLint height = 576;
+GLuint VertexArrayID;
+
+float matrix[16] = {
+    1.0f / ((float)width/2.0f), 0.0f, 0.0f, 0.0f,
+    0.0f, 1.0f / ((float)height/2.0f), 0.0f, 0.0f,
+    0.0f, 0.0f, 1.0f, 0.0f,
+    0.0f, 0.0f, 0.0f, 1.0f
+};
+
+// Static Model-View-Projection matrix
+glm::mat4 MVP = glm::make_mat4(matrix);
+
+void configureVertexArray(struct arrayObject *obj){
+    if (obj->vertexArrayID == 0) glGenVertexArrays(1, &obj->vertexArrayID);
+    stateBindVertexArray(obj->vertexArrayID);
+
+    // Attribute 2 stays disabled, drawArray sets the color as a constant
+    stateBindBuffer(GL_ARRAY_BUFFER, obj->vertexBuffer);
+    setVertexAttributes(obj->layout ? *obj->layout : positionLayout, obj->vertexOffset);
+}
+
+static void configureVertexArray(struct texturePolygon *obj){
+    if (obj->vertexArrayID == 0) glGenVertexArrays(1, &obj->vertexArrayID);
+    stateBindVertexArray(obj->vertexArrayID);
+
+    stateBindBuffer(GL_ARRAY_BUFFER, obj->vertexBuffer);
+    if (obj->layout){
+        setVertexAttributes(*obj->layout, 0);
+        return;
+    }
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(0);
+
+    stateBindBuffer(GL_ARRAY_BUFFER, obj->uvBuffer);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(1);
+}
+
+static void configureVertexArray(struct instancedObject *obj, bool textured){
+    if (obj->vertexArrayID == 0) glGenVertexArrays(1, &obj->vertexArrayID);
+    stateBindVertexArray(obj->vertexArrayID);
+
+    stateBindBuffer(GL_ARRAY_BUFFER, obj->vertexBuffer);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(0);
+
+    if (textured){
+        stateBindBuffer(GL_ARRAY_BUFFER, obj->uvBuffer);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+        glEnableVertexAttribArray(1);
+    }
+
+    // The divisors are VAO state, so they are set once here
+    GLsizei stride = INSTANCE_STRIDE * sizeof(GLfloat);
+    stateBindBuffer(GL_ARRAY_BUFFER, obj->instanceBuffer);
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, stride, (void*)(2 * sizeof(GLfloat)));
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(GLfloat)));
+    for (GLuint i = 2; i <= 4; i++){
+        glEnableVertexAttribArray(i);
+        glVertexAttribDivisor(i, 1);
+    }
+}
+
+// The element array binding is VAO state too
+static void configureVertexArray(struct indexedMesh *obj){
+    if (obj->vertexArrayID == 0) glGenVertexArrays(1, &obj->vertexArrayID);
+    stateBindVertexArray(obj->vertexArrayID);
+
+    stateBindBuffer(GL_ARRAY_BUFFER, obj->vertexBuffer);
+    setVertexAttributes(obj->layout ? *obj->layout : textureLayout, obj->vertexOffset);
+
+    stateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, obj->indexBuffer);
+}
+
+// defragmentPool callbacks
+static void arrayMoved(void *owner){
+    configureVertexArray((arrayObject*)owner);
+}
+
+static void meshMoved(void *owner){
+    configureVertexArray((indexedMesh*)owner);
+}
+
+// Copies data into *buffer, or into a pool range when there is no buffer or
+// it is already a pool block. Goes through the copy target, so no VAO's
+// element array binding changes.
+static void uploadData(GLuint *buffer, GLintptr *offset, GLsizeiptr size, const void *data,
+                       poolMovedFunction moved, void *owner){
+    if (*buffer == 0 || poolOwns(*buffer)){
+        if (*buffer) poolFree(*buffer, *offset);
+        poolAllocate(size, buffer, offset, moved, owner);
+        poolWrite(*buffer, *offset, size, data);
+        return;
+    }
+    *offset = 0;
+    stateBindBuffer(GL_COPY_WRITE_BUFFER, *buffer);
+    stateBufferData(GL_COPY_WRITE_BUFFER, size, data, GL_STATIC_DRAW);
+}
+
+static void releaseData(GLuint *buffer, GLintptr *offset){
+    if (poolOwns(*buffer)) poolFree(*buffer, *offset);
+    else if (*buffer) stateDeleteBuffers(1, buffer);
+    *buffer = 0;
+    *offset = 0;
+}
+
+// Packs count vertices into layout for upload
+static unique_ptr<char[]> packArray(vertexLayout const& layout, const GLfloat *const *sources,
+                                 const int *strides, GLuint count){
+    unique_ptr<char[]> packed(new char[(size_t)layout.stride * count]); // Not zeroed, every byte is written
+    packVertices(layout, packed.get(), sources, strides, count);
+    return packed;
+}
+
+void uploadArray(struct arrayObject *obj){
+    GLuint count = obj->vertexArrayLength / 3;
+    obj->bounds = computeBounds(obj->vertexArray, count, 3);
+    if (obj->layout){
+        const GLfloat *sources[] = {obj->vertexArray};
+        int strides[] = {3};
+        uploadData(&obj->vertexBuffer, &obj->vertexOffset, (GLsizeiptr)obj->layout->stride * count,
+                   packArray(*obj->layout, sources, strides, count).get(), arrayMoved, obj);
+    } else {
+        uploadData(&obj->vertexBuffer, &obj->vertexOffset, sizeof(GLfloat) * obj->vertexArrayLength,
+                   obj->vertexArray, arrayMoved, obj);
+    }
+    obj->vertexArray = NULL;
+    configureVertexArray(obj);
+}
+
+void allocateArray(struct arrayObject *obj, GLsizeiptr size, const void *data){
+    poolAllocate(size, &obj->vertexBuffer, &obj->vertexOffset, arrayMoved, obj);
+    poolWrite(obj->vertexBuffer, obj->vertexOffset, size, data);
+    configureVertexArray(obj);
+}
+
+void deleteArray(struct arrayObject *obj){
+    releaseData(&obj->vertexBuffer, &obj->vertexOffset);
+    stateDeleteVertexArrays(1, &obj->vertexArrayID);
+    obj->vertexArrayID = 0;
+}
+
+void deleteArray(struct indexedMesh *obj){
+    releaseData(&obj->vertexBuffer, &obj->vertexOffset);
+    releaseData(&obj->indexBuffer, &obj->indexOffset);
+    stateDeleteVertexArrays(1, &obj->vertexArrayID);
+    obj->vertexArrayID = 0;
+}
+
+void uploadArray(struct texturePolygon *obj){
+    obj->bounds = computeBounds(obj->vertexBufferArray, obj->arrayLength, 3);
+    stateBindBuffer(GL_ARRAY_BUFFER, obj->vertexBuffer);
+    if (obj->layout){
+        const GLfloat *sources[] = {obj->vertexBufferArray, obj->uvBufferArray};
+        int strides[] = {3, 2};
+        stateBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)obj->layout->stride * obj->arrayLength,
+                        packArray(*obj->layout, sources, strides, obj->arrayLength).get(), GL_STATIC_DRAW);
+    } else {
+        stateBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 3 * obj->arrayLength, obj->vertexBufferArray, GL_STATIC_DRAW);
+
+        stateBindBuffer(GL_ARRAY_BUFFER, obj->uvBuffer);
+        stateBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 2 * obj->arrayLength, obj->uvBufferArray, GL_STATIC_DRAW);
+    }
+    obj->vertexBufferArray = NULL;
+    obj->uvBufferArray = NULL;
+    configureVertexArray(obj);
+}
+
+void uploadArray(struct instancedObject *obj){
+    // Each instance is the geometry scaled, then moved to its offset
+    bounds2D shape = computeBounds(obj->vertexArray, obj->vertexCount, 3);
+    bounds2D offsets = computeBounds(obj->instanceArray, obj->instanceCount, INSTANCE_STRIDE);
+    GLfloat scale = 0.0f;
+    for (GLuint i = 0; i < obj->instanceCount; i++)
+        scale = max(scale, obj->instanceArray[i * INSTANCE_STRIDE + 2]);
+    obj->bounds.minX = offsets.minX + min(0.0f, shape.minX * scale);
+    obj->bounds.minY = offsets.minY + min(0.0f, shape.minY * scale);
+    obj->bounds.maxX = offsets.maxX + max(0.0f, shape.maxX * scale);
+    obj->bounds.maxY = offsets.maxY + max(0.0f, shape.maxY * scale);
+
+    stateBindBuffer(GL_ARRAY_BUFFER, obj->vertexBuffer);
+    stateBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 3 * obj->vertexCount, obj->vertexArray, GL_STATIC_DRAW);
+
+    bool textured = obj->uvArray != NULL;
+    if (textured){
+        stateBindBuffer(GL_ARRAY_BUFFER, obj->uvBuffer);
+        stateBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 2 * obj->vertexCount, obj->uvArray, GL_STATIC_DRAW);
+    }
+
+    stateBindBuffer(GL_ARRAY_BUFFER, obj->instanceBuffer);
+    stateBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * INSTANCE_STRIDE * obj->instanceCount,
+                 obj->instanceArray, GL_STATIC_DRAW);
+
+    obj->vertexArray = NULL;
+    obj->uvArray = NULL;
+    obj->instanceArray = NULL;
+    configureVertexArray(obj, textured);
+}
+
+void uploadArray(struct indexedMesh *obj){
+    obj->bounds = computeBounds(obj->vertexArray, obj->vertexCount, MESH_STRIDE);
+    if (obj->layout){
+        const GLfloat *sources[] = {obj->vertexArray, obj->vertexArray + 3};
+        int strides[] = {MESH_STRIDE, MESH_STRIDE};
+        uploadData(&obj->vertexBuffer, &obj->vertexOffset, (GLsizeiptr)obj->layout->stride * obj->vertexCount,
+                   packArray(*obj->layout, sources, strides, obj->vertexCount).get(), meshMoved, obj);
+    } else {
+        uploadData(&obj->vertexBuffer, &obj->vertexOffset, sizeof(GLfloat) * MESH_STRIDE * obj->vertexCount,
+                   obj->vertexArray, meshMoved, obj);
+    }
+
+    // Packed to 16 bits when every index fits, halving the buffer
+    if (obj->vertexCount <= 65536){
+        vector<GLushort> packed(obj->indexArray, obj->indexArray + obj->indexCount);
+        uploadData(&obj->indexBuffer, &obj->indexOffset, sizeof(GLushort) * obj->indexCount,
+                   packed.data(), meshMoved, obj);
+        obj->indexType = GL_UNSIGNED_SHORT;
+    } else {
+        uploadData(&obj->indexBuffer, &obj->indexOffset, sizeof(GLuint) * obj->indexCount,
+                   obj->indexArray, meshMoved, obj);
+        obj->indexType = GL_UNSIGNED_INT;
+    }
+
+    obj->vertexArray = NULL;
+    obj->indexArray = NULL;
+    configureVertexArray(obj);
+}
+
+// The VAOs hold the attribute setup, and the state cache drops the program,
+// texture and uniform calls that repeat what is already bound
+void drawArray(struct arrayObject *obj){
+    stateUseProgram(obj->shader);
+
+    stateVertexAttrib3fv(2, glm::value_ptr(obj->colorVec)); // Constant color attribute
+    stateUniform1i(obj->shader, obj->objectID, obj->objectIndex);
+
+    stateBindVertexArray(obj->vertexArrayID);
+    glDrawArrays(obj->mode, 0, obj->vertexArrayLength / 3);
+}
+
+void drawArrayTexture(struct texturePolygon *obj){
+    stateUseProgram(obj->shader);
+
+    stateBindTexture(0, GL_TEXTURE_2D, obj->texture);
+    stateUniform1i(obj->shader, obj->textureID, 0);
+
+    stateBindVertexArray(obj->vertexArrayID);
+    glDrawArrays(GL_TRIANGLES, 0, obj->arrayLength);
+}
+
+void drawArrayInstanced(struct instancedObject *obj){
+    stateUseProgram(obj->shader);
+
+    if (obj->texture){
+        stateBindTexture(0, GL_TEXTURE_2D, obj->texture);
+        stateUniform1i(obj->shader, obj->textureID, 0);
+    }
+
+    stateBindVertexArray(obj->vertexArrayID);
+    glDrawArraysInstanced(obj->mode, 0, obj->vertexCount, obj->instanceCount);
+    stateInvalidateAttribute(2); // Read per instance here, drawArray sets it as a constant
+}
+
+void drawElements(struct indexedMesh *obj){
+    stateUseProgram(obj->shader);
+
+    stateBindTexture(0, GL_TEXTURE_2D, obj->texture);
+    stateUniform1i(obj->shader, obj->textureID, 0);
+
+    stateBindVertexArray(obj->vertexArrayID);
+    glDrawElements(GL_TRIANGLES, obj->indexCount, obj->indexType, (void*)obj->indexOffset);
+}
+
+void getUniform(struct arrayObject *obj){
+    obj->objectID = glGetUniformLocation(obj->shader, "uObject");
+}
+
+void getUniform(struct texturePolygon *obj){
+    obj->textureID = glGetUniformLocation(obj->shader, "myTextureSampler");
+}
+
+void getUniform(struct instancedObject *obj){
+    obj->textureID = glGetUniformLocation(obj->shader, "myTextureSampler");
+}
+
+void getUniform(struct indexedMesh *obj){
+    obj->textureID = glGetUniformLocation(obj->shader, "myTextureSampler");
+}
+
+void init(){
+    createContext(width, height); // Window, or offscreen FBO when headless
+
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_GREATER);
+    glClearDepth(-1.0f);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+
+    // Default Vertex Array Object, uploaded objects get their own
+    stateInvalidate();
+    glGenVertexArrays(1, &VertexArrayID);
+    stateBindVertexArray(VertexArrayID);
+}
+
+int fileRead(string const& filename, string* result){
+    ifstream ifs(filename.data());
+    if(ifs.is_open()) {
+        *result = string((istreambuf_iterator<char>(ifs)),
+                              (istreambuf_iterator<char>()));
+        ifs.close();
+        return 0;
+    }
+    return -1;
+}
+
+static void printShaderError(GLuint shaderObj, GLenum shaderType, string const& msg){
+    GLchar errorLog[1024] = { 0 };
+    glGetShaderInfoLog(shaderObj, 1024, NULL, errorLog);
+    cout << msg << " " << shaderType << ": " << errorLog << endl;
+    exit(EXIT_FAILURE);
+}
+
+static void printProgramError(GLuint program, string const& msg){
+    GLchar errorLog[1024] = { 0 };
+    glGetProgramInfoLog(program, 1024, NULL, errorLog);
+    cout << msg << ": " << errorLog << endl;
+    exit(EXIT_FAILURE);
+}
+
+// Compiles without waiting, the status is checked in finishProgram
+static GLuint submitShader(string const& shaderString, GLenum shaderType, GLuint m_program){
+    GLuint shaderObj = glCreateShader(shaderType);
+
+    if (shaderObj == 0){
+        cout << "Fatal: Error creating shader type ";
+        if (shaderType == GL_VERTEX_SHADER) cout << "GL_VERTEX_SHADER" << endl;
+        else if (shaderType == GL_FRAGMENT_SHADER) cout << "GL_FRAGMENT_SHADER" << endl;
+        else if (shaderType == GL_COMPUTE_SHADER) cout << "GL_COMPUTE_SHADER" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    GLchar const* str = shaderString.data();
+    GLint length = shaderString.size();
+    glShaderSource(shaderObj, 1, &str, &length);
+    glCompileShader(shaderObj);
+
+    glAttachShader(m_program, shaderObj);
+    return shaderObj;
+}
+
+// Programs submitted by compileShaderAsync that nobody has seen linked yet
+struct pendingProgram {
+    GLuint program;
+    GLuint shaders[2];
+    GLenum shaderTypes[2];
+    string vs;
+    string fs;
+};
+
+static vector<pendingProgram> pendingPrograms;
+
+static void finishProgram(pendingProgram const& pending){
+    GLint success;
+    for (int i = 0; i < 2; i++){
+        glGetShaderiv(pending.shaders[i], GL_COMPILE_STATUS, &success);
+        if (success == 0)
+            printShaderError(pending.shaders[i], pending.shaderTypes[i], "Fatal: Error compiling shader type");
+    }
+
+    GLuint program = pending.program;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if(success == 0) {
+        printProgramError(program, "Fatal: Error linking shader program");
+    }
+
+    glValidateProgram(program);
+    glGetProgramiv(program, GL_VALIDATE_STATUS, &success);
+    if(success == 0) {
+        printProgramError(program, "Fatal: Invalid shader program");
+    }
+
+    // The linked program keeps working without its shader objects
+    for (int i = 0; i < 2; i++){
+        glDetachShader(program, pending.shaders[i]);
+        glDeleteShader(pending.shaders[i]);
+    }
+    saveProgram(pending.vs, pending.fs, program);
+    bindProgramUniforms(program);
+}
+
+// Finishes the program if it is pending and done, or if wait is set
+static bool pollProgram(GLuint program, bool wait){
+    for (size_t i = 0; i < pendingPrograms.size(); i++){
+        if (pendingPrograms[i].program != program) continue;
+
+        if (!wait && GLEW_KHR_parallel_shader_compile){
+            GLint done = GL_FALSE;
+            glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &done);
+            if (!done) return false;
+        }
+        finishProgram(pendingPrograms[i]);
+        pendingPrograms.erase(pendingPrograms.begin() + i);
+        return true;
+    }
+    return true;
+}
+
+GLuint compileShaderAsync(string const& vs, string const& fs){
+    // Block bindings are not part of a stored binary, so set them again
+    GLuint program = findProgram(vs, fs);
+    if (program){
+        bindProgramUniforms(program);
+        return program;
+    }
+
+    // Let the driver compile on as many threads as it likes
+    static bool threadsSet = false;
+    if (!threadsSet && GLEW_KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    threadsSet = true;
+
+    program = glCreateProgram();
+    assert(program != 0 && "Fatal: Error creating shader program.");
+
+    pendingProgram pending;
+    pending.program = program;
+    pending.shaderTypes[0] = GL_VERTEX_SHADER;
+    pending.shaderTypes[1] = GL_FRAGMENT_SHADER;
+    pending.shaders[0] = submitShader(vs, GL_VERTEX_SHADER, program);
+    pending.shaders[1] = submitShader(fs, GL_FRAGMENT_SHADER, program);
+    pending.vs = vs;
+    pending.fs = fs;
+
+    prepareProgram(program);
+    glLinkProgram(program);
+
+    storeProgram(vs, fs, program);
+    pendingPrograms.push_back(pending);
+    return program;
+}
+
+bool programReady(GLuint program){
+    return pollProgram(program, false);
+}
+
+void finishPrograms(){
+    while (!pendingPrograms.empty())
+        pollProgram(pendingPrograms.back().program, true);
+}
+
+GLuint compileShader(string const& vs, string const& fs){
+    GLuint program = compileShaderAsync(vs, fs);
+    pollProgram(program, true);
+    return program;
+}
+
+GLuint compileComputeShader(string const& cs){
+    GLuint program = findProgram(cs, "");
+    if (program){
+        bindProgramUniforms(program);
+        return program;
+    }
+
+    program = glCreateProgram();
+    assert(program != 0 && "Fatal: Error creating shader program.");
+    GLuint shader = submitShader(cs, GL_COMPUTE_SHADER, program);
+    prepareProgram(program);
+    glLinkProgram(program);
+    storeProgram(cs, "", program);
+
+    GLint success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (success == 0) printShaderError(shader, GL_COMPUTE_SHADER, "Fatal: Error compiling shader type");
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (success == 0) printProgramError(program, "Fatal: Error linking shader program");
+
+    glDetachShader(program, shader);
+    glDeleteShader(shader);
+    saveProgram(cs, "", program);
+    bindProgramUniforms(program);
+    return program;
+}
@@ -0,0 +1,161 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <string>
+
+#include "Cull.h"
+#include "VertexLayout.h"
+
+struct arrayObject {
+    GLuint mode;
+    GLuint shader;
+    glm::vec3 colorVec;
+    GLuint vertexBuffer; // 0 before uploadArray sub-allocates from the pool (BufferPool.h)
+    GLfloat *vertexArray; // Arena memory, dropped by uploadArray
+    GLuint vertexArrayLength; // Number of floats, three per vertex
+    GLint objectID; // uObject, -1 unless the shader reads an objectBuffer
+    GLint objectIndex; // This object's record in that buffer
+    GLintptr vertexOffset; // Byte offset into vertexBuffer, e.g. a stream region
+    GLuint vertexArrayID; // Own VAO, set up by uploadArray
+    const vertexLayout *layout; // NULL for positionLayout
+    bounds2D bounds; // Model space, set by uploadArray. Cull transformBounds of it with an objectBuffer.
+};
+
+struct texturePolygon {
+    GLuint texture;
+    GLuint shader;
+    GLint textureID;
+    GLuint vertexBuffer;
+    GLuint uvBuffer;
+    GLfloat *vertexBufferArray; // Arena memory, dropped by uploadArray
+    GLfloat *uvBufferArray;
+    GLuint arrayLength; // Number of vertices
+    GLuint vertexArrayID;
+    GLfloat layer; // Texture array layer, set by remapUVs for atlas batches
+    const vertexLayout *layout; // Interleaved into vertexBuffer, NULL keeps two float buffers
+    bounds2D bounds;
+};
+
+// Textured triangles drawn with glDrawElements. Position and UV are
+// interleaved in one buffer, and each distinct vertex is stored once. Build
+// it with weldMesh and optimizeMesh from Mesh.h. vertexArray is always
+// MESH_STRIDE floats per vertex, packed into the layout on upload.
+struct indexedMesh {
+    GLuint texture;
+    GLuint shader;
+    GLint textureID;
+    GLuint vertexBuffer; // Both 0 before uploadArray sub-allocates from the pool
+    GLuint indexBuffer;
+    GLintptr vertexOffset; // Bytes into the buffers, set by uploadArray
+    GLintptr indexOffset;
+    GLfloat *vertexArray; // Arena memory, dropped by uploadArray
+    GLuint *indexArray;
+    GLuint vertexCount;
+    GLuint indexCount;
+    GLenum indexType; // Set by uploadArray, 16-bit while the vertices allow it
+    GLuint vertexArrayID;
+    const vertexLayout *layout; // NULL for textureLayout
+    bounds2D bounds;
+};
+
+// Floats per vertex in indexedMesh::vertexArray, position.xyz then uv
+static const int MESH_STRIDE = 5;
+
+// One shared piece of geometry drawn many times with glDrawArraysInstanced.
+// Each instance has an offset, a scale and a color (attributes 3, 4 and 2).
+// Use the colorInstanced/textureInstanced vertex shaders with it.
+struct instancedObject {
+    GLuint mode;
+    GLuint shader;
+    GLuint texture; // 0 draws untextured
+    GLuint vertexBuffer;
+    GLuint uvBuffer;
+    GLuint instanceBuffer;
+    GLfloat *vertexArray; // Arena memory, dropped by uploadArray
+    GLfloat *uvArray;     // NULL when untextured
+    GLuint vertexCount;
+    GLfloat *instanceArray; // offset.xy, scale, color.rgb per instance
+    GLuint instanceCount;
+    GLint textureID;
+    GLuint vertexArrayID;
+    bounds2D bounds; // Covers every instance
+};
+
+// Floats per instance in instancedObject::instanceArray
+static const int INSTANCE_STRIDE = 6;
+
+// Half of colorVertex.vert's gl_PointSize. Culling grows the view by this
+// much, so points just off-screen whose sprites reach into it still draw.
+static const GLfloat CULL_MARGIN = 10.0f;
+
+extern GLint width;
+extern GLint height;
+extern GLuint VertexArrayID;
+
+// Static Model-View-Projection matrix. Shaders read it from the Frame block,
+// so call updateFrameUniforms (Uniforms.h) after changing it.
+extern glm::mat4 MVP;
+
+// Copies the geometry to the GPU, packed into the object's layout, notes
+// its bounds for culling and drops the CPU pointers. The arena they came
+// from can be reset once all of its objects are uploaded. Arrays and meshes
+// without a buffer of their own get a range of the buffer pool, which
+// defragmentPool may move; they must then stay at the same address until
+// deleteArray.
+void uploadArray(struct arrayObject *obj);
+void uploadArray(struct texturePolygon *obj);
+void uploadArray(struct instancedObject *obj);
+void uploadArray(struct indexedMesh *obj);
+
+// Copies size bytes, already packed in the object's layout, into a pool
+// range and sets up its VAO. Bounds are left as they are.
+void allocateArray(struct arrayObject *obj, GLsizeiptr size, const void *data);
+
+// Frees the object's pool ranges, or deletes the buffers it owns, and its VAO.
+// Arrays drawn from a buffer shared some other way, such as a stream, should
+// have vertexBuffer cleared first.
+void deleteArray(struct arrayObject *obj);
+void deleteArray(struct indexedMesh *obj);
+
+// Points the object's VAO at vertexBuffer and vertexOffset. uploadArray does
+// this once; call it again after moving the data, e.g. to a new stream region.
+void configureVertexArray(struct arrayObject *obj);
+
+void drawArray(struct arrayObject *obj);
+void drawArrayTexture(struct texturePolygon *obj);
+void drawArrayInstanced(struct instancedObject *obj);
+void drawElements(struct indexedMesh *obj);
+
+// Get the uniform location of uploaded programs
+void getUniform(struct arrayObject *obj);
+void getUniform(struct texturePolygon *obj);
+void getUniform(struct instancedObject *obj);
+void getUniform(struct indexedMesh *obj);
+
+// Creates the context and sets the OpenGL settings shared by all scenes
+void init();
+
+int fileRead(std::string const& filename, std::string* result);
+
+// Programs with the same sources are shared through ProgramCache.h, so
+// release them with releaseProgram rather than deleting them
+GLuint compileShader(std::string const& vs, std::string const& fs);
+
+// Submits the compile and link and returns at once. The driver works on it
+// in the background with KHR_parallel_shader_compile; without it, the first
+// programReady blocks. Don't draw with, or query uniforms of, a program
+// until programReady has returned true for it.
+GLuint compileShaderAsync(std::string const& vs, std::string const& fs);
+bool programReady(GLuint program);
+
+// Blocks until every submitted program is ready
+void finishPrograms();
+
+// A compute program, cached like the others under an empty fragment source.
+// Needs GL 4.3, and always waits for the link.
+GLuint compileComputeShader(std::string const& cs);
+
+#endif
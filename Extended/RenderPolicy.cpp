@@ -0,0 +1,113 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+
+#include "Context.h"
+#include "RenderPolicy.h"
+
+using namespace std;
+
+typedef chrono::steady_clock paceClock;
+
+// Sleeps can end a scheduler tick late, so the last stretch before a fixed
+// rate frame is spent yielding instead
+static const chrono::milliseconds SPIN_TIME(2);
+
+renderPolicy policy = {RENDER_CONTINUOUS, 60.0, -1};
+
+static atomic<bool> redrawRequested(true); // The first frame always draws
+static GLFWkeyfun previousKeyCallback = NULL;
+static paceClock::time_point nextFrame;
+static bool paced = false;
+
+static renderMode parseMode(string const& name){
+    if (name == "continuous") return RENDER_CONTINUOUS;
+    if (name == "fixed") return RENDER_FIXED;
+    if (name == "on-demand") return RENDER_ON_DEMAND;
+    cerr << "Fatal: Unknown render mode " << name << endl;
+    exit(EXIT_FAILURE);
+}
+
+void parseRenderPolicyOptions(int argc, char *argv[]){
+    for (int i = 1; i < argc; i++){
+        string arg = argv[i];
+        if (arg == "--render" && i + 1 < argc) policy.mode = parseMode(argv[++i]);
+        else if (arg == "--fps" && i + 1 < argc) policy.rate = atof(argv[++i]);
+        else if (arg == "--vsync" && i + 1 < argc) policy.swapInterval = max(0, atoi(argv[++i]));
+        else if (arg == "--no-vsync") policy.swapInterval = 0;
+    }
+
+    if (policy.rate <= 0.0){
+        cerr << "Fatal: --fps needs a positive rate" << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Input that can change what is shown. Plain cursor motion is left out, the
+// scene does not follow it.
+static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods){
+    if (previousKeyCallback) previousKeyCallback(window, key, scancode, action, mods);
+    requestRedraw();
+}
+
+static void refreshCallback(GLFWwindow* window){ requestRedraw(); }
+static void sizeCallback(GLFWwindow* window, int width, int height){ requestRedraw(); }
+static void buttonCallback(GLFWwindow* window, int button, int action, int mods){ requestRedraw(); }
+static void scrollCallback(GLFWwindow* window, double x, double y){ requestRedraw(); }
+
+void applyRenderPolicy(){
+    if (!window) return;
+
+    // Fixed mode does its own pacing, vsync on top would round it to the refresh rate
+    int interval = policy.swapInterval;
+    if (interval < 0) interval = policy.mode == RENDER_FIXED ? 0 : 1;
+    glfwSwapInterval(interval);
+
+    previousKeyCallback = glfwSetKeyCallback(window, keyCallback);
+    glfwSetWindowRefreshCallback(window, refreshCallback);
+    glfwSetFramebufferSizeCallback(window, sizeCallback);
+    glfwSetMouseButtonCallback(window, buttonCallback);
+    glfwSetScrollCallback(window, scrollCallback);
+}
+
+static void sleepUntilNextFrame(){
+    paceClock::duration period =
+        chrono::duration_cast<paceClock::duration>(chrono::duration<double>(1.0 / policy.rate));
+    paceClock::time_point now = paceClock::now();
+
+    // Starting out, or so far behind that catching up would mean a burst
+    if (!paced || now - nextFrame > period){
+        nextFrame = now;
+        paced = true;
+    }
+    if (nextFrame - now > SPIN_TIME) this_thread::sleep_until(nextFrame - SPIN_TIME);
+    while (paceClock::now() < nextFrame) this_thread::yield();
+    nextFrame += period;
+}
+
+void waitForFrame(bool busy){
+    if (policy.mode == RENDER_FIXED) sleepUntilNextFrame();
+    if (policy.mode != RENDER_ON_DEMAND || !window) return;
+
+    glfwPollEvents();
+    while (!redrawRequested.exchange(false)){
+        if (glfwWindowShouldClose(window)) return;
+        if (busy){
+            glfwWaitEventsTimeout(1.0 / policy.rate);
+            return;
+        }
+        glfwWaitEvents();
+    }
+}
+
+void requestRedraw(){
+    redrawRequested = true;
+    if (window) glfwPostEmptyEvent();
+}
@@ -0,0 +1,40 @@
+#ifndef RENDERPOLICY_H
+#define RENDERPOLICY_H
+
+// When the main loop draws. Continuous mode draws every time round, paced by
+// vsync. Fixed mode sleeps until the next tick of a fixed rate. On-demand
+// mode blocks in glfwWaitEvents and only draws once input or the scene asks
+// for it through requestRedraw, so a static scene costs next to nothing.
+// Headless runs have no events to wait for and draw every frame.
+enum renderMode {
+    RENDER_CONTINUOUS,
+    RENDER_FIXED,
+    RENDER_ON_DEMAND
+};
+
+struct renderPolicy {
+    renderMode mode;
+    double rate;      // Frames per second in fixed mode
+    int swapInterval; // Passed to glfwSwapInterval, -1 picks 1 except in fixed mode
+};
+
+extern renderPolicy policy;
+
+// Parses --render continuous|fixed|on-demand, --fps HZ, --vsync N and
+// --no-vsync
+void parseRenderPolicyOptions(int argc, char *argv[]);
+
+// Sets the swap interval and hooks the input callbacks. Call after init().
+void applyRenderPolicy();
+
+// Returns once the next frame is due. Only on-demand mode handles events
+// here, to learn whether one is; call contextPollEvents in the frame for the
+// rest. In on-demand mode, busy keeps it waking at the fixed rate instead of
+// blocking, for scenes that still change on their own, such as textures
+// that are loading.
+void waitForFrame(bool busy);
+
+// Marks the frame as out of date and wakes waitForFrame. Safe from any thread.
+void requestRedraw();
+
+#endif
@@ -0,0 +1,195 @@
+#include <GL/glew.h>
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "Context.h"
+#include "Render.h"
+#include "Resolution.h"
+
+using namespace std;
+
+resolutionOptions resolution = {0.0, 1.0f, 0.0f, 0.0f};
+GLfloat renderScale = 1.0f;
+
+// Timestamp pairs in flight, so a result is read a few frames after it was
+// issued and never stalls
+static const int RESOLUTION_QUERIES = 4;
+
+struct timingSlot {
+    GLuint queries[2]; // Before and after the scene
+    GLfloat scale;     // The frame was drawn at
+    bool pending;
+};
+
+static bool enabled = false;
+static timingSlot slots[RESOLUTION_QUERIES];
+static int nextSlot = 0;
+static GLuint sceneFrameBuffer = 0;
+static GLuint colorBuffer = 0;
+static GLuint depthBuffer = 0;
+static GLint renderWidth = 0;
+static GLint renderHeight = 0;
+static vector<double> samples; // Scene GPU times at renderScale, in milliseconds
+static double lastAverageMs = 0.0;
+static unsigned long changes = 0;
+
+void parseResolutionOptions(int argc, char *argv[]){
+    bool hasMin = false, hasMax = false;
+    for (int i = 1; i < argc - 1; i++){
+        string arg = argv[i];
+        if (arg == "--dynamic-resolution") resolution.targetMs = atof(argv[++i]);
+        else if (arg == "--render-scale") resolution.scale = atof(argv[++i]);
+        else if (arg == "--min-scale"){
+            resolution.minScale = atof(argv[++i]);
+            hasMin = true;
+        } else if (arg == "--max-scale"){
+            resolution.maxScale = atof(argv[++i]);
+            hasMax = true;
+        }
+    }
+
+    // Only scales that were not given get defaults, a given 0 is an error
+    enabled = resolution.targetMs > 0.0 || resolution.scale != 1.0f;
+    if (!hasMin && resolution.minScale <= 0.0f) resolution.minScale = min(0.5f, resolution.scale);
+    if (!hasMax && resolution.maxScale <= 0.0f) resolution.maxScale = max(1.0f, resolution.scale);
+    if (!(resolution.scale > 0.0f) || !(resolution.minScale > 0.0f) ||
+        resolution.minScale > resolution.scale || resolution.scale > resolution.maxScale ||
+        resolution.maxScale > 2.0f){
+        cerr << "Fatal: Scales must be 0 < --min-scale <= --render-scale <= --max-scale <= 2" << endl;
+        exit(EXIT_FAILURE);
+    }
+    renderScale = enabled ? resolution.scale : 1.0f;
+}
+
+bool resolutionEnabled(){
+    return enabled;
+}
+
+GLint scaledSize(GLint size){
+    return max(1, (GLint)(size * renderScale + 0.5f));
+}
+
+// Sized for the largest scale, smaller ones draw into its corner, so
+// changing the scale never reallocates
+static void createTarget(){
+    GLint targetWidth = (GLint)ceil(width * resolution.maxScale);
+    GLint targetHeight = (GLint)ceil(height * resolution.maxScale);
+
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, targetWidth, targetHeight);
+
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, targetWidth, targetHeight);
+
+    glGenFramebuffers(1, &sceneFrameBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFrameBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE){
+        cerr << "Fatal: Scaled framebuffer of " << targetWidth << "x" << targetHeight << " is incomplete" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < RESOLUTION_QUERIES; i++){
+        glGenQueries(2, slots[i].queries);
+        slots[i].pending = false;
+    }
+}
+
+// Reads the slot's times, waiting for them with wait set. Frames drawn at
+// an older scale say nothing about this one and are dropped.
+static bool collect(timingSlot *slot, bool wait){
+    if (!slot->pending) return false;
+    GLint available = 1;
+    if (!wait) glGetQueryObjectiv(slot->queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) return false;
+
+    GLuint64 begin = 0, end = 0;
+    glGetQueryObjectui64v(slot->queries[0], GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(slot->queries[1], GL_QUERY_RESULT, &end);
+    slot->pending = false;
+    if (slot->scale == renderScale) samples.push_back((end - begin) / 1e6);
+    return true;
+}
+
+// Pixels, and so fill time, go with the square of the scale. Aims for the
+// middle of the band between RESOLUTION_HEADROOM and the target.
+static void chooseScale(){
+    if (resolution.targetMs <= 0.0 || samples.size() < (size_t)RESOLUTION_WINDOW) return;
+    double average = 0.0;
+    for (size_t i = 0; i < samples.size(); i++) average += samples[i];
+    average /= samples.size();
+    samples.clear();
+    lastAverageMs = average;
+    if (average <= resolution.targetMs && average >= resolution.targetMs * RESOLUTION_HEADROOM) return;
+
+    double aim = resolution.targetMs * (1.0 + RESOLUTION_HEADROOM) / 2.0;
+    GLfloat wanted = renderScale * sqrt(aim / max(average, 1e-3));
+    wanted = min(wanted, renderScale + RESOLUTION_MAX_GROWTH);
+    wanted = floor(wanted / RESOLUTION_STEP + 1e-3f) * RESOLUTION_STEP; // Rounded towards cheaper
+    wanted = min(max(wanted, resolution.minScale), resolution.maxScale);
+    if (wanted == renderScale) return;
+    renderScale = wanted;
+    changes++;
+}
+
+void beginScaledFrame(){
+    if (!enabled) return;
+    if (!sceneFrameBuffer) createTarget();
+
+    renderWidth = scaledSize(width);
+    renderHeight = scaledSize(height);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFrameBuffer);
+    glViewport(0, 0, renderWidth, renderHeight);
+
+    timingSlot &slot = slots[nextSlot];
+    collect(&slot, true); // Only waits if every slot is still in flight
+    glQueryCounter(slot.queries[0], GL_TIMESTAMP);
+}
+
+void endScaledFrame(){
+    if (!enabled) return;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFrameBuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frameBufferID);
+    glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, frameBufferID); // Read back by captures and --output
+    glViewport(0, 0, width, height);
+
+    // The upscale counts too, it is part of what the frame costs
+    timingSlot &slot = slots[nextSlot];
+    glQueryCounter(slot.queries[1], GL_TIMESTAMP);
+    slot.scale = renderScale;
+    slot.pending = true;
+    nextSlot = (nextSlot + 1) % RESOLUTION_QUERIES;
+
+    // Oldest first, stopping at the first one not done
+    for (int i = 0; i < RESOLUTION_QUERIES; i++)
+        if (!collect(&slots[(nextSlot + i) % RESOLUTION_QUERIES], false)) break;
+    chooseScale();
+}
+
+void printResolutionStatistics(ostream &out){
+    if (!enabled) return;
+    out << "Dynamic resolution: scale " << fixed << setprecision(2) << renderScale << " ("
+        << resolution.minScale << " to " << resolution.maxScale << "), " << changes << " changes";
+    if (resolution.targetMs > 0.0)
+        out << ", scene " << lastAverageMs << " ms against " << resolution.targetMs << " ms";
+    out << endl;
+}
+
+void finishResolution(){
+    if (!sceneFrameBuffer) return;
+    glDeleteFramebuffers(1, &sceneFrameBuffer);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    glDeleteRenderbuffers(1, &depthBuffer);
+    for (int i = 0; i < RESOLUTION_QUERIES; i++) glDeleteQueries(2, slots[i].queries);
+    sceneFrameBuffer = colorBuffer = depthBuffer = 0;
+}
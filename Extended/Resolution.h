@@ -0,0 +1,56 @@
+#ifndef RESOLUTION_H
+#define RESOLUTION_H
+
+#include <GL/glew.h>
+
+#include <iostream>
+
+// Dynamic resolution. The scene is drawn into an offscreen framebuffer at
+// renderScale times the window size, then stretched over the window with a
+// linear blit. The GPU time of the scene and its upscale is measured with
+// timestamp queries read back a few frames later. Once a full window of
+// frames has been measured at one scale, the scale is moved so the average
+// lands inside the target. Averages between RESOLUTION_HEADROOM and 1 times
+// the target leave it alone, so the resolution settles instead of
+// oscillating.
+
+static const int RESOLUTION_WINDOW = 8;            // Frames averaged at one scale before it may change
+static const double RESOLUTION_HEADROOM = 0.75;    // Scale up only below this share of the target
+static const GLfloat RESOLUTION_STEP = 0.05f;      // Scales are whole multiples of this
+static const GLfloat RESOLUTION_MAX_GROWTH = 0.1f; // Largest single step up, growing is the riskier way
+
+struct resolutionOptions {
+    double targetMs;  // GPU time the scene may take, 0 keeps the scale fixed
+    GLfloat scale;    // Starting scale
+    GLfloat minScale;
+    GLfloat maxScale; // Above 1 renders more pixels than the window has
+};
+
+extern resolutionOptions resolution;
+
+// Render target pixels per window pixel, 1 unless scaling is on. Sizes given
+// in window pixels, such as gl_PointSize, are multiplied by it.
+extern GLfloat renderScale;
+
+// Parses --dynamic-resolution TARGET_MS, --render-scale S, --min-scale S and
+// --max-scale S. Either of the first two turns scaling on.
+void parseResolutionOptions(int argc, char *argv[]);
+bool resolutionEnabled();
+
+// A window dimension in render target pixels
+GLint scaledSize(GLint size);
+
+// Binds the scaled target and its viewport and starts timing. Call before
+// clearing, and before updateFrameUniforms so the shaders see the scale.
+void beginScaledFrame();
+
+// Stops timing, upscales into the window or headless framebuffer and leaves
+// that bound, then picks the next frame's scale. Call before captureFrame.
+void endScaledFrame();
+
+void printResolutionStatistics(std::ostream &out);
+
+// Deletes the target and the queries. Call before destroying the context.
+void finishResolution();
+
+#endif
@@ -0,0 +1,139 @@
+// Converts a text scene, as in scene.txt, into a binary scene file
+// (SceneFile.h) that the template maps and streams in with --scene. The text
+// is read one line at a time and written out chunk by chunk, so inputs of
+// any size convert in little memory.
+//
+//   ./sceneconvert INPUT.txt OUTPUT.glsc
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+#include "SceneFile.h"
+#include "VertexLayout.h"
+
+using namespace std;
+
+struct textObject {
+    GLenum mode;
+    glm::vec3 color;
+    vector<GLfloat> positions; // xyz, the part not written yet
+    bool flat; // Every z so far is 0, so z can be left out
+    unsigned long vertexCount;
+};
+
+static string input;
+static unsigned long lineNumber = 0;
+
+static void fail(string const& message){
+    cerr << "Fatal: " << input << ":" << lineNumber << ": " << message << endl;
+    exit(EXIT_FAILURE);
+}
+
+static GLenum parseMode(string const& name){
+    if (name == "points") return GL_POINTS;
+    if (name == "lines") return GL_LINES;
+    if (name == "triangles") return GL_TRIANGLES;
+    fail("Unknown mode " + name + ", expected points, lines or triangles");
+    return GL_POINTS;
+}
+
+static GLuint primitiveVertices(GLenum mode){
+    return mode == GL_TRIANGLES ? 3 : mode == GL_LINES ? 2 : 1;
+}
+
+static void writeChunk(sceneFileWriter *writer, textObject *obj){
+    GLuint count = obj->positions.size() / 3;
+    writeSceneChunk(writer, obj->mode, obj->color, obj->flat ? compactPositionLayout : positionLayout,
+                    obj->positions.data(), count);
+    obj->positions.clear();
+    obj->flat = true;
+}
+
+static void finishObject(sceneFileWriter *writer, textObject *obj){
+    if (obj->vertexCount % primitiveVertices(obj->mode) != 0)
+        fail("Object ends partway through a primitive");
+    writeChunk(writer, obj);
+}
+
+int main(int argc, char *argv[]){
+    if (argc != 3){
+        cerr << "Usage: " << argv[0] << " INPUT.txt OUTPUT.glsc" << endl;
+        return EXIT_FAILURE;
+    }
+    input = argv[1];
+
+    ifstream in(argv[1]);
+    if (!in.is_open()){
+        cerr << "Fatal: Could not open " << argv[1] << endl;
+        return EXIT_FAILURE;
+    }
+    sceneFileWriter writer;
+    if (!beginSceneFile(&writer, argv[2])){
+        cerr << "Fatal: Could not write " << argv[2] << endl;
+        return EXIT_FAILURE;
+    }
+
+    textObject obj = {GL_POINTS, glm::vec3(1.0f), vector<GLfloat>(), true, 0};
+    bool started = false;
+    GLuint chunkVertices = SCENE_CHUNK_VERTICES;
+    unsigned long vertices = 0;
+    string line;
+    while (getline(in, line)){
+        lineNumber++;
+        size_t comment = line.find('#');
+        if (comment != string::npos) line.erase(comment);
+
+        istringstream fields(line);
+        string first;
+        if (!(fields >> first)) continue;
+
+        if (first == "object"){
+            if (started) finishObject(&writer, &obj);
+            string mode;
+            if (!(fields >> mode >> obj.color.x >> obj.color.y >> obj.color.z))
+                fail("Expected object MODE R G B");
+            obj.mode = parseMode(mode);
+            obj.vertexCount = 0;
+            started = true;
+
+            // Whole primitives per chunk
+            chunkVertices = SCENE_CHUNK_VERTICES - SCENE_CHUNK_VERTICES % primitiveVertices(obj.mode);
+            continue;
+        }
+
+        if (!started) fail("Vertex before the first object line");
+        const char *text = line.c_str();
+        char *end;
+        GLfloat position[3] = {0.0f, 0.0f, 0.0f};
+        int components = 0;
+        for (; components < 3; components++){
+            position[components] = strtof(text, &end);
+            if (end == text) break;
+            text = end;
+        }
+        while (*text == ' ' || *text == '\t' || *text == '\r') text++;
+        if (components < 2 || *text != '\0') fail("Expected a vertex, x y [z]");
+
+        obj.positions.insert(obj.positions.end(), position, position + 3);
+        obj.flat = obj.flat && position[2] == 0.0f;
+        obj.vertexCount++;
+        vertices++;
+        if (obj.positions.size() / 3 == chunkVertices) writeChunk(&writer, &obj);
+    }
+    if (started) finishObject(&writer, &obj);
+
+    size_t chunks = writer.chunks.size();
+    if (!finishSceneFile(&writer)){
+        cerr << "Fatal: Could not write " << argv[2] << endl;
+        return EXIT_FAILURE;
+    }
+    cout << "Wrote " << vertices << " vertices in " << chunks << " chunks to " << argv[2] << endl;
+    return EXIT_SUCCESS;
+}
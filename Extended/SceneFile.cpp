@@ -0,0 +1,224 @@
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <assert.h>
+
+#include "SceneFile.h"
+#include "State.h"
+
+using namespace std;
+
+typedef chrono::steady_clock sceneClock;
+
+static GLuint64 alignOffset(GLuint64 offset){
+    return (offset + SCENE_ALIGNMENT - 1) / SCENE_ALIGNMENT * SCENE_ALIGNMENT;
+}
+
+static bool validLayout(vertexLayout const& layout){
+    if (layout.count < 1 || layout.count > MAX_LAYOUT_ATTRIBUTES || layout.stride <= 0) return false;
+    for (int a = 0; a < layout.count; a++){
+        vertexAttribute const& attribute = layout.attributes[a];
+        if (attribute.components < 1 || attribute.components > 4) return false;
+        if (attribute.offset >= (GLuint)layout.stride) return false;
+    }
+    return layout.attributes[0].location == 0; // Positions, as the shaders expect
+}
+
+static bool validChunk(sceneChunk const& chunk, size_t fileSize){
+    return chunk.offset % SCENE_ALIGNMENT == 0 && chunk.offset <= fileSize &&
+           chunk.size <= fileSize - chunk.offset && validLayout(chunk.layout) &&
+           chunk.size == (GLuint64)chunk.vertexCount * chunk.layout.stride &&
+           (chunk.mode == GL_POINTS || chunk.mode == GL_LINES || chunk.mode == GL_TRIANGLES);
+}
+
+bool openSceneFile(const char *file_name, GLuint shader, sceneFile *scene){
+    scene->shader = shader;
+    scene->chunks = NULL;
+    scene->chunkCount = 0;
+    scene->streamed = 0;
+    scene->objects.clear();
+    scene->layouts.clear();
+    scene->uniformsReady = false;
+
+    if (!mapFile(file_name, &scene->file)){
+        cerr << "Could not open scene " << file_name << endl;
+        return false;
+    }
+
+    const unsigned char *data = scene->file.data;
+    size_t size = scene->file.size;
+    const sceneHeader *header = (const sceneHeader*)data;
+    bool valid = size >= sizeof(sceneHeader) && memcmp(header->magic, SCENE_MAGIC, 4) == 0 &&
+                 header->version == SCENE_VERSION && header->tableOffset % SCENE_ALIGNMENT == 0 &&
+                 header->tableOffset <= size &&
+                 header->chunkCount <= (size - header->tableOffset) / sizeof(sceneChunk);
+    if (valid){
+        scene->chunks = (const sceneChunk*)(data + header->tableOffset);
+        for (GLuint i = 0; i < header->chunkCount && valid; i++)
+            valid = validChunk(scene->chunks[i], size);
+    }
+    if (!valid){
+        cerr << file_name << " is not a version " << SCENE_VERSION << " scene file" << endl;
+        unmapFile(&scene->file);
+        scene->chunks = NULL;
+        return false;
+    }
+
+    scene->chunkCount = header->chunkCount;
+    scene->bounds = header->bounds;
+
+    // Copied out, the objects point at these
+    scene->layouts.resize(scene->chunkCount);
+    scene->objects.resize(scene->chunkCount);
+    for (GLuint i = 0; i < scene->chunkCount; i++){
+        sceneChunk const& chunk = scene->chunks[i];
+        scene->layouts[i] = chunk.layout;
+
+        arrayObject &obj = scene->objects[i];
+        obj = arrayObject();
+        obj.mode = chunk.mode;
+        obj.shader = shader;
+        obj.colorVec = glm::vec3(chunk.color[0], chunk.color[1], chunk.color[2]);
+        obj.vertexArrayLength = chunk.vertexCount * 3;
+        obj.layout = &scene->layouts[i];
+        obj.bounds = chunk.bounds;
+    }
+    return true;
+}
+
+static void uploadChunk(sceneFile *scene, GLuint i){
+    sceneChunk const& chunk = scene->chunks[i];
+    arrayObject &obj = scene->objects[i];
+
+    // Chunks are small and many, so they share pooled buffers
+    allocateArray(&obj, chunk.size, scene->file.data + chunk.offset);
+
+    // The GL has its own copy now. The next chunk in the file is the likely
+    // next upload, so it is read in meanwhile.
+    releaseMappedRange(&scene->file, chunk.offset, chunk.size);
+    if (i + 1 < scene->chunkCount && !scene->objects[i + 1].vertexBuffer)
+        prefetchMappedRange(&scene->file, scene->chunks[i + 1].offset, scene->chunks[i + 1].size);
+    scene->streamed++;
+}
+
+bool streamSceneFile(sceneFile *scene, bounds2D const& view, double budgetMs){
+    sceneClock::time_point start = sceneClock::now();
+    bool uploaded = false;
+
+    // What is in view first, so the first frames show what is looked at
+    for (int pass = 0; pass < 2 && scene->streamed < scene->chunkCount; pass++){
+        for (GLuint i = 0; i < scene->chunkCount; i++){
+            arrayObject &obj = scene->objects[i];
+            if (obj.vertexBuffer || (pass == 0 && !boundsOverlap(obj.bounds, view))) continue;
+            if (uploaded && chrono::duration<double, milli>(sceneClock::now() - start).count() >= budgetMs)
+                return false;
+            uploadChunk(scene, i);
+            uploaded = true;
+        }
+    }
+    return scene->streamed == scene->chunkCount;
+}
+
+void drawSceneFile(sceneFile *scene, bounds2D const& view){
+    if (scene->streamed == 0 || !programReady(scene->shader)) return;
+    if (!scene->uniformsReady){
+        for (GLuint i = 0; i < scene->chunkCount; i++) getUniform(&scene->objects[i]);
+        scene->uniformsReady = true;
+    }
+
+    for (GLuint i = 0; i < scene->chunkCount; i++){
+        arrayObject &obj = scene->objects[i];
+        if (obj.vertexBuffer && boundsOverlap(obj.bounds, view)) drawArray(&obj);
+    }
+}
+
+void closeSceneFile(sceneFile *scene){
+    for (GLuint i = 0; i < scene->chunkCount; i++){
+        arrayObject &obj = scene->objects[i];
+        if (obj.vertexBuffer) deleteArray(&obj);
+    }
+    scene->objects.clear();
+    scene->layouts.clear();
+    scene->chunks = NULL;
+    scene->chunkCount = 0;
+    scene->streamed = 0;
+    if (scene->file.data) unmapFile(&scene->file);
+}
+
+bool beginSceneFile(sceneFileWriter *writer, const char *file_name){
+    writer->path = file_name;
+    writer->chunks.clear();
+    writer->offset = SCENE_ALIGNMENT; // The header is written last, in front
+    writer->bounds.minX = writer->bounds.minY = numeric_limits<GLfloat>::max();
+    writer->bounds.maxX = writer->bounds.maxY = -numeric_limits<GLfloat>::max();
+
+    // Written aside and renamed, so a crash never leaves half a file behind
+    writer->out.open((writer->path + ".tmp").c_str(), ios::binary | ios::trunc);
+    return writer->out.is_open();
+}
+
+void writeSceneChunk(sceneFileWriter *writer, GLenum mode, glm::vec3 color,
+                     vertexLayout const& layout, const GLfloat *positions, GLuint vertexCount){
+    assert(layout.count == 1 && layout.attributes[0].location == 0 && "Scene chunks only hold positions");
+    if (vertexCount == 0) return;
+
+    sceneChunk chunk;
+    memset(&chunk, 0, sizeof(chunk));
+    chunk.offset = writer->offset;
+    chunk.size = (GLuint64)vertexCount * layout.stride;
+    chunk.vertexCount = vertexCount;
+    chunk.mode = mode;
+    chunk.color[0] = color.x;
+    chunk.color[1] = color.y;
+    chunk.color[2] = color.z;
+    chunk.bounds = computeBounds(positions, vertexCount, 3);
+    chunk.layout = layout;
+
+    unique_ptr<char[]> packed(new char[chunk.size]);
+    const GLfloat *sources[MAX_LAYOUT_ATTRIBUTES] = {positions};
+    int strides[MAX_LAYOUT_ATTRIBUTES] = {3};
+    packVertices(layout, packed.get(), sources, strides, vertexCount);
+    writer->out.seekp(chunk.offset);
+    writer->out.write(packed.get(), chunk.size);
+
+    writer->bounds.minX = min(writer->bounds.minX, chunk.bounds.minX);
+    writer->bounds.minY = min(writer->bounds.minY, chunk.bounds.minY);
+    writer->bounds.maxX = max(writer->bounds.maxX, chunk.bounds.maxX);
+    writer->bounds.maxY = max(writer->bounds.maxY, chunk.bounds.maxY);
+    writer->offset = alignOffset(chunk.offset + chunk.size);
+    writer->chunks.push_back(chunk);
+}
+
+bool finishSceneFile(sceneFileWriter *writer){
+    sceneHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SCENE_MAGIC, 4);
+    header.version = SCENE_VERSION;
+    header.tableOffset = writer->offset;
+    header.chunkCount = writer->chunks.size();
+    header.bounds = writer->bounds;
+
+    writer->out.seekp(header.tableOffset);
+    writer->out.write((const char*)writer->chunks.data(), writer->chunks.size() * sizeof(sceneChunk));
+    writer->out.seekp(0);
+    writer->out.write((const char*)&header, sizeof(header));
+    writer->out.close();
+
+    string temporary = writer->path + ".tmp";
+    if (writer->out.fail()){
+        remove(temporary.c_str());
+        return false;
+    }
+    remove(writer->path.c_str());
+    return rename(temporary.c_str(), writer->path.c_str()) == 0;
+}
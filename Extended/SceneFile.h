@@ -0,0 +1,96 @@
+#ifndef SCENEFILE_H
+#define SCENEFILE_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Cull.h"
+#include "MappedFile.h"
+#include "Render.h"
+#include "VertexLayout.h"
+
+// Binary scene files (.glsc), written by sceneconvert from the text format
+// in scene.txt. A header comes first, then the vertex chunks, then the chunk
+// table. Each chunk holds the vertices of one draw, already packed in its
+// vertex layout, so the bytes go from the mapped file to a VBO unchanged.
+// Chunks start on page boundaries, so each one can be read in and released
+// on its own.
+
+static const char SCENE_MAGIC[4] = {'G', 'L', 'S', 'C'};
+static const GLuint SCENE_VERSION = 1;
+static const GLuint64 SCENE_ALIGNMENT = 4096;
+static const GLuint SCENE_CHUNK_VERTICES = 65536; // At most, sceneconvert splits larger objects
+
+struct sceneHeader {
+    char magic[4];
+    GLuint version;
+    GLuint64 tableOffset;
+    GLuint chunkCount;
+    bounds2D bounds; // Of the whole scene
+};
+
+struct sceneChunk {
+    GLuint64 offset; // Bytes into the file
+    GLuint64 size;
+    GLuint vertexCount;
+    GLenum mode;
+    GLfloat color[3];
+    bounds2D bounds;
+    vertexLayout layout;
+};
+
+// An open scene file. The chunks are streamed into VBOs over several
+// frames, those in view first, and their pages are released once uploaded,
+// so a file of any size keeps little more than its chunk table resident.
+struct sceneFile {
+    mappedFile file;
+    GLuint shader;
+    const sceneChunk *chunks; // The table, in the mapping
+    GLuint chunkCount;
+    GLuint streamed; // Chunks uploaded so far
+    std::vector<arrayObject> objects; // One per chunk, vertexBuffer 0 until streamed into the pool
+    std::vector<vertexLayout> layouts;
+    bool uniformsReady;
+    bounds2D bounds;
+};
+
+// Maps the file and checks the table. Nothing is uploaded yet. Returns false,
+// with the reason on cerr, if the file is missing or malformed. Objects are
+// drawn with shader, which takes a constant color like drawArray.
+bool openSceneFile(const char *file_name, GLuint shader, sceneFile *scene);
+
+// Uploads chunks, those overlapping view first, until budgetMs has been
+// spent, at least one per call. Returns true once every chunk is uploaded.
+bool streamSceneFile(sceneFile *scene, bounds2D const& view, double budgetMs);
+
+// Draws the uploaded chunks that overlap view, once the shader is ready
+void drawSceneFile(sceneFile *scene, bounds2D const& view);
+
+void closeSceneFile(sceneFile *scene);
+
+// Writes a scene file chunk by chunk, so the geometry never has to fit in
+// memory at once
+struct sceneFileWriter {
+    std::ofstream out;
+    std::string path;
+    std::vector<sceneChunk> chunks;
+    GLuint64 offset;
+    bounds2D bounds;
+};
+
+bool beginSceneFile(sceneFileWriter *writer, const char *file_name);
+
+// Packs vertexCount xyz float positions into layout, which holds only a
+// position, and appends them as one chunk. Lines and triangles must not be
+// split across chunks.
+void writeSceneChunk(sceneFileWriter *writer, GLenum mode, glm::vec3 color,
+                     vertexLayout const& layout, const GLfloat *positions, GLuint vertexCount);
+
+// Writes the table and header, and moves the file into place
+bool finishSceneFile(sceneFileWriter *writer);
+
+#endif
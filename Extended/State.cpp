@@ -0,0 +1,335 @@
+#ifdef WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#endif
+
+#include <GL/glew.h>
+
+#include <iostream>
+#include <iomanip>
+#include <unordered_map>
+#include <map>
+#include <string>
+#include <cstring>
+
+#include "State.h"
+
+using namespace std;
+
+bool stateCacheEnabled = true;
+
+// Never a valid GL name, so the first bind after an invalidate is issued
+static const GLuint STATE_UNKNOWN = 0xFFFFFFFF;
+static const int STATE_TEXTURE_UNITS = 16;
+static const int STATE_ATTRIBUTES = 16;
+
+static const GLenum bufferTargets[] = {
+    GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_PIXEL_PACK_BUFFER,
+    GL_PIXEL_UNPACK_BUFFER, GL_UNIFORM_BUFFER, GL_DRAW_INDIRECT_BUFFER,
+    GL_TEXTURE_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+    GL_SHADER_STORAGE_BUFFER
+};
+static const int BUFFER_TARGETS = sizeof(bufferTargets) / sizeof(bufferTargets[0]);
+
+static const GLenum textureTargets[] = {GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BUFFER};
+static const int TEXTURE_TARGETS = sizeof(textureTargets) / sizeof(textureTargets[0]);
+
+struct uniformValue {
+    GLsizei size; // Bytes used in data
+    GLfloat data[16];
+};
+
+static const char* kindNames[] = {"program", "vertex array", "buffer", "texture",
+                                  "uniform", "attribute"};
+
+struct liveObject {
+    const char *tag;
+    size_t bytes;
+};
+
+static GLuint program = STATE_UNKNOWN;
+static GLuint vertexArray = STATE_UNKNOWN;
+static GLuint buffers[BUFFER_TARGETS];
+static GLuint activeUnit = STATE_UNKNOWN;
+static GLuint textures[STATE_TEXTURE_UNITS][TEXTURE_TARGETS];
+static GLfloat attributes[STATE_ATTRIBUTES][3];
+static bool attributeKnown[STATE_ATTRIBUTES];
+static unordered_map<GLuint64, uniformValue> uniforms;
+static unordered_map<GLuint, liveObject> liveBuffers;
+static unordered_map<GLuint, liveObject> liveTextures;
+static stateObjects objects;
+static stateStats stats;
+static bool initialized = false;
+
+static int bufferIndex(GLenum target){
+    for (int i = 0; i < BUFFER_TARGETS; i++)
+        if (bufferTargets[i] == target) return i;
+    return -1;
+}
+
+static int textureIndex(GLenum target){
+    for (int i = 0; i < TEXTURE_TARGETS; i++)
+        if (textureTargets[i] == target) return i;
+    return -1;
+}
+
+// Counts the call and says whether it still has to reach GL
+static bool changed(stateKind kind, bool redundant){
+    if (!initialized) stateInvalidate();
+    if (redundant){
+        stats.skipped[kind]++;
+        if (stateCacheEnabled) return false;
+    }
+    stats.issued[kind]++;
+    return true;
+}
+
+void stateUseProgram(GLuint newProgram){
+    if (!changed(STATE_PROGRAM, program == newProgram)) return;
+    glUseProgram(newProgram);
+    program = newProgram;
+}
+
+void stateBindVertexArray(GLuint newVertexArray){
+    if (!changed(STATE_VERTEX_ARRAY, vertexArray == newVertexArray)) return;
+    glBindVertexArray(newVertexArray);
+    vertexArray = newVertexArray;
+
+    // The element array binding belongs to the VAO
+    buffers[bufferIndex(GL_ELEMENT_ARRAY_BUFFER)] = STATE_UNKNOWN;
+}
+
+void stateBindBuffer(GLenum target, GLuint buffer){
+    int index = bufferIndex(target);
+    if (index < 0){
+        changed(STATE_BUFFER, false);
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if (!changed(STATE_BUFFER, buffers[index] == buffer)) return;
+    glBindBuffer(target, buffer);
+    buffers[index] = buffer;
+}
+
+void stateBindBufferBase(GLenum target, GLuint index, GLuint buffer){
+    changed(STATE_BUFFER, false);
+    glBindBufferBase(target, index, buffer);
+
+    // The generic binding point changes as well
+    int t = bufferIndex(target);
+    if (t >= 0) buffers[t] = buffer;
+}
+
+void stateBindTexture(GLuint unit, GLenum target, GLuint texture){
+    int index = textureIndex(target);
+    if (index < 0 || unit >= (GLuint)STATE_TEXTURE_UNITS){
+        changed(STATE_TEXTURE, false);
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture);
+        activeUnit = unit;
+        return;
+    }
+    if (!changed(STATE_TEXTURE, textures[unit][index] == texture)) return;
+    if (activeUnit != unit){
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+    }
+    glBindTexture(target, texture);
+    textures[unit][index] = texture;
+}
+
+// Stores size bytes of value for program/location, true if they differ
+static bool storeUniform(GLuint program, GLint location, const void *value, GLsizei size){
+    uniformValue &stored = uniforms[((GLuint64)program << 32) | (GLuint)location];
+    if (stored.size == size && memcmp(stored.data, value, size) == 0) return false;
+    stored.size = size;
+    memcpy(stored.data, value, size);
+    return true;
+}
+
+// Uniforms are set on the bound program, so the program is bound first
+void stateUniform1i(GLuint program, GLint location, GLint value){
+    if (location < 0) return;
+    stateUseProgram(program);
+    if (!changed(STATE_UNIFORM, !storeUniform(program, location, &value, sizeof(value)))) return;
+    glUniform1i(location, value);
+}
+
+void stateUniform1f(GLuint program, GLint location, GLfloat value){
+    if (location < 0) return;
+    stateUseProgram(program);
+    if (!changed(STATE_UNIFORM, !storeUniform(program, location, &value, sizeof(value)))) return;
+    glUniform1f(location, value);
+}
+
+void stateUniformMatrix4fv(GLuint program, GLint location, const GLfloat *value){
+    if (location < 0) return;
+    stateUseProgram(program);
+    if (!changed(STATE_UNIFORM, !storeUniform(program, location, value, 16 * sizeof(GLfloat)))) return;
+    glUniformMatrix4fv(location, 1, GL_FALSE, value);
+}
+
+void stateVertexAttrib3fv(GLuint index, const GLfloat *value){
+    if (index >= (GLuint)STATE_ATTRIBUTES){
+        changed(STATE_ATTRIBUTE, false);
+        glVertexAttrib3fv(index, value);
+        return;
+    }
+    bool redundant = attributeKnown[index] && memcmp(attributes[index], value, sizeof(attributes[index])) == 0;
+    if (!changed(STATE_ATTRIBUTE, redundant)) return;
+    glVertexAttrib3fv(index, value);
+    memcpy(attributes[index], value, sizeof(attributes[index]));
+    attributeKnown[index] = true;
+}
+
+void stateInvalidateAttribute(GLuint index){
+    if (index < (GLuint)STATE_ATTRIBUTES) attributeKnown[index] = false;
+}
+
+void stateDeletePrograms(GLsizei n, const GLuint *programs){
+    for (GLsizei i = 0; i < n; i++){
+        glDeleteProgram(programs[i]);
+
+        // The name can come back from glCreateProgram with other uniforms
+        for (unordered_map<GLuint64, uniformValue>::iterator it = uniforms.begin(); it != uniforms.end();){
+            if ((GLuint)(it->first >> 32) == programs[i]) it = uniforms.erase(it);
+            else ++it;
+        }
+        if (program == programs[i]) program = STATE_UNKNOWN;
+    }
+}
+
+void stateDeleteVertexArrays(GLsizei n, const GLuint *vertexArrays){
+    glDeleteVertexArrays(n, vertexArrays);
+    for (GLsizei i = 0; i < n; i++){
+        if (vertexArray == vertexArrays[i]){
+            vertexArray = 0;
+            buffers[bufferIndex(GL_ELEMENT_ARRAY_BUFFER)] = STATE_UNKNOWN;
+        }
+    }
+}
+
+// Forgets a deleted name, returning its bytes
+static size_t forget(unordered_map<GLuint, liveObject> *live, GLuint name){
+    unordered_map<GLuint, liveObject>::iterator it = live->find(name);
+    if (it == live->end()) return 0;
+    size_t bytes = it->second.bytes;
+    live->erase(it);
+    return bytes;
+}
+
+void stateDeleteBuffers(GLsizei n, const GLuint *deleted){
+    glDeleteBuffers(n, deleted);
+    for (GLsizei i = 0; i < n; i++){
+        for (int t = 0; t < BUFFER_TARGETS; t++)
+            if (buffers[t] == deleted[i]) buffers[t] = 0;
+        if (liveBuffers.count(deleted[i])){
+            objects.bufferBytes -= forget(&liveBuffers, deleted[i]);
+            objects.buffers--;
+        }
+    }
+}
+
+void stateDeleteTextures(GLsizei n, const GLuint *deleted){
+    glDeleteTextures(n, deleted);
+    for (GLsizei i = 0; i < n; i++){
+        for (int u = 0; u < STATE_TEXTURE_UNITS; u++)
+            for (int t = 0; t < TEXTURE_TARGETS; t++)
+                if (textures[u][t] == deleted[i]) textures[u][t] = 0;
+        if (liveTextures.count(deleted[i])){
+            objects.textureBytes -= forget(&liveTextures, deleted[i]);
+            objects.textures--;
+        }
+    }
+}
+
+void stateGenBuffers(GLsizei n, GLuint *created, const char *tag){
+    glGenBuffers(n, created);
+    for (GLsizei i = 0; i < n; i++){
+        liveObject object = {tag, 0};
+        liveBuffers[created[i]] = object;
+    }
+    objects.buffers += n;
+}
+
+void stateGenTextures(GLsizei n, GLuint *created, const char *tag){
+    glGenTextures(n, created);
+    for (GLsizei i = 0; i < n; i++){
+        liveObject object = {tag, 0};
+        liveTextures[created[i]] = object;
+    }
+    objects.textures += n;
+}
+
+void stateBufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage){
+    glBufferData(target, size, data, usage);
+    int t = bufferIndex(target);
+    if (t >= 0) stateBufferBytes(buffers[t], size);
+}
+
+void stateBufferBytes(GLuint buffer, size_t bytes){
+    unordered_map<GLuint, liveObject>::iterator it = liveBuffers.find(buffer);
+    if (it == liveBuffers.end()) return;
+    objects.bufferBytes += bytes - it->second.bytes;
+    it->second.bytes = bytes;
+}
+
+void stateTextureBytes(GLuint texture, size_t bytes){
+    unordered_map<GLuint, liveObject>::iterator it = liveTextures.find(texture);
+    if (it == liveTextures.end()) return;
+    objects.textureBytes += bytes - it->second.bytes;
+    it->second.bytes = bytes;
+}
+
+void stateInvalidate(){
+    initialized = true;
+    program = STATE_UNKNOWN;
+    vertexArray = STATE_UNKNOWN;
+    activeUnit = STATE_UNKNOWN;
+    for (int t = 0; t < BUFFER_TARGETS; t++) buffers[t] = STATE_UNKNOWN;
+    for (int u = 0; u < STATE_TEXTURE_UNITS; u++)
+        for (int t = 0; t < TEXTURE_TARGETS; t++) textures[u][t] = STATE_UNKNOWN;
+    for (int i = 0; i < STATE_ATTRIBUTES; i++) attributeKnown[i] = false;
+    uniforms.clear();
+}
+
+stateStats const& stateStatistics(){
+    return stats;
+}
+
+void resetStateStatistics(){
+    stats = stateStats();
+}
+
+stateObjects const& stateObjectStatistics(){
+    return objects;
+}
+
+static void printLive(ostream &out, const char *kind, unordered_map<GLuint, liveObject> const& live){
+    map<string, pair<unsigned long, size_t> > byTag; // Sorted, so reports compare
+    for (unordered_map<GLuint, liveObject>::const_iterator it = live.begin(); it != live.end(); ++it){
+        pair<unsigned long, size_t> &entry = byTag[it->second.tag];
+        entry.first++;
+        entry.second += it->second.bytes;
+    }
+    for (map<string, pair<unsigned long, size_t> >::iterator it = byTag.begin(); it != byTag.end(); ++it){
+        out << "  " << left << setw(8) << kind << setw(24) << it->first << right
+            << setw(8) << it->second.first << setw(14) << it->second.second << endl;
+    }
+}
+
+void printLiveObjects(ostream &out){
+    out << "Live GL objects: " << objects.buffers << " buffers of " << objects.bufferBytes
+        << " bytes, " << objects.textures << " textures of " << objects.textureBytes << " bytes" << endl;
+    printLive(out, "buffer", liveBuffers);
+    printLive(out, "texture", liveTextures);
+}
+
+void printStateStatistics(ostream &out){
+    out << "GL state calls" << (stateCacheEnabled ? "" : " (cache disabled)")
+        << ": issued, redundant" << endl;
+    for (int k = 0; k < STATE_KINDS; k++){
+        out << "  " << left << setw(14) << kindNames[k] << right
+            << setw(10) << stats.issued[k] << setw(10) << stats.skipped[k] << endl;
+    }
+}
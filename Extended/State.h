@@ -0,0 +1,83 @@
+#ifndef STATE_H
+#define STATE_H
+
+#include <GL/glew.h>
+
+#include <ostream>
+
+// Shadows the GL binding state so calls that would not change anything are
+// skipped. Everything that binds programs, VAOs, buffers or textures, sets
+// uniforms or deletes those objects has to go through here, otherwise the
+// shadow copy goes stale; call stateInvalidate after code that does not.
+// Buffers and textures are also created here, so every live one is known
+// with its size and what it is for.
+enum stateKind {
+    STATE_PROGRAM,
+    STATE_VERTEX_ARRAY,
+    STATE_BUFFER,
+    STATE_TEXTURE,
+    STATE_UNIFORM,
+    STATE_ATTRIBUTE, // Constant generic attribute values
+    STATE_KINDS
+};
+
+struct stateStats {
+    unsigned long issued[STATE_KINDS];
+    unsigned long skipped[STATE_KINDS];
+};
+
+// Buffers and textures alive now, and the bytes they hold
+struct stateObjects {
+    unsigned long buffers, textures;
+    size_t bufferBytes, textureBytes;
+};
+
+// When false every call is forwarded, but redundant ones are still counted
+extern bool stateCacheEnabled;
+
+// tag says what the objects are for, in printLiveObjects. It must outlive
+// them, a string literal usually.
+void stateGenBuffers(GLsizei n, GLuint *buffers, const char *tag);
+void stateGenTextures(GLsizei n, GLuint *textures, const char *tag);
+
+// glBufferData on the buffer bound to target, noting its new size
+void stateBufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage);
+
+// Note the size of storage made some other way, e.g. glBufferStorage, or
+// the bytes of all of a texture's images after glTexImage and friends
+void stateBufferBytes(GLuint buffer, size_t bytes);
+void stateTextureBytes(GLuint texture, size_t bytes);
+
+void stateUseProgram(GLuint program);
+void stateBindVertexArray(GLuint vertexArray);
+void stateBindBuffer(GLenum target, GLuint buffer);
+void stateBindBufferBase(GLenum target, GLuint index, GLuint buffer); // Always issued
+void stateBindTexture(GLuint unit, GLenum target, GLuint texture);
+
+// Uniform values are kept per program, so they survive switching programs
+void stateUniform1i(GLuint program, GLint location, GLint value);
+void stateUniform1f(GLuint program, GLint location, GLfloat value);
+void stateUniformMatrix4fv(GLuint program, GLint location, const GLfloat *value);
+void stateVertexAttrib3fv(GLuint index, const GLfloat *value);
+
+// Draws that read an enabled array leave the attribute's constant undefined
+void stateInvalidateAttribute(GLuint index);
+
+void stateDeletePrograms(GLsizei n, const GLuint *programs);
+void stateDeleteVertexArrays(GLsizei n, const GLuint *vertexArrays);
+void stateDeleteBuffers(GLsizei n, const GLuint *buffers);
+void stateDeleteTextures(GLsizei n, const GLuint *textures);
+
+// Forgets everything, the next call of each kind is always issued
+void stateInvalidate();
+
+stateStats const& stateStatistics();
+void resetStateStatistics();
+void printStateStatistics(std::ostream &out);
+
+stateObjects const& stateObjectStatistics();
+
+// Lists the buffers and textures still alive by tag, e.g. leaks at exit
+void printLiveObjects(std::ostream &out);
+
+#endif
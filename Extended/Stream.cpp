@@ -0,0 +1,132 @@
+#ifdef WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#endif
+
+#include <GL/glew.h>
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <assert.h>
+
+#include "State.h"
+#include "Stream.h"
+
+using namespace std;
+
+static const GLsizeiptr STREAM_ALIGNMENT = 256;
+static const GLuint64 STREAM_WAIT_NS = 1000000;
+
+void createStream(vertexStream *stream, GLsizeiptr bytesPerFrame, streamMode mode){
+    if (mode == STREAM_AUTO)
+        mode = GLEW_ARB_buffer_storage ? STREAM_PERSISTENT : STREAM_ORPHAN;
+    if (mode == STREAM_PERSISTENT && !GLEW_ARB_buffer_storage){
+        cerr << "Persistent mapping is not supported, orphaning instead" << endl;
+        mode = STREAM_ORPHAN;
+    }
+
+    stream->mode = mode;
+    stream->regionSize = (bytesPerFrame + STREAM_ALIGNMENT - 1) / STREAM_ALIGNMENT * STREAM_ALIGNMENT;
+    stream->region = 0;
+    stream->persistent = NULL;
+    stream->stalls = 0;
+    for (int i = 0; i < STREAM_REGIONS; i++) stream->fences[i] = 0;
+
+    stateGenBuffers(1, &stream->buffer, "vertex stream");
+    stateBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+
+    if (mode == STREAM_PERSISTENT){
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, stream->regionSize * STREAM_REGIONS, NULL, flags);
+        stateBufferBytes(stream->buffer, stream->regionSize * STREAM_REGIONS);
+        stream->persistent = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0,
+                                                     stream->regionSize * STREAM_REGIONS, flags);
+        assert(stream->persistent != NULL && "Could not map persistent stream buffer");
+    } else if (mode == STREAM_UNSYNCHRONIZED){
+        stateBufferData(GL_ARRAY_BUFFER, stream->regionSize * STREAM_REGIONS, NULL, GL_STREAM_DRAW);
+    } else {
+        stateBufferData(GL_ARRAY_BUFFER, stream->regionSize, NULL, GL_STREAM_DRAW);
+    }
+}
+
+void deleteStream(vertexStream *stream){
+    for (int i = 0; i < STREAM_REGIONS; i++){
+        if (stream->fences[i]) glDeleteSync(stream->fences[i]);
+        stream->fences[i] = 0;
+    }
+
+    if (stream->persistent){
+        stateBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        stream->persistent = NULL;
+    }
+    stateDeleteBuffers(1, &stream->buffer);
+}
+
+// Blocks only if the GPU is still reading the region from STREAM_REGIONS frames ago
+static void waitRegion(vertexStream *stream){
+    GLsync fence = stream->fences[stream->region];
+    if (!fence) return;
+
+    GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (status == GL_TIMEOUT_EXPIRED) stream->stalls++;
+    while (status == GL_TIMEOUT_EXPIRED)
+        status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, STREAM_WAIT_NS);
+
+    glDeleteSync(fence);
+    stream->fences[stream->region] = 0;
+}
+
+void* beginStream(vertexStream *stream, GLsizeiptr bytes){
+    assert(bytes <= stream->regionSize && "Stream region is too small for this frame");
+
+    if (stream->mode == STREAM_ORPHAN){
+        stateBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+        stateBufferData(GL_ARRAY_BUFFER, stream->regionSize, NULL, GL_STREAM_DRAW);
+        return glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes,
+                                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    }
+
+    waitRegion(stream);
+    GLintptr offset = stream->region * stream->regionSize;
+    if (stream->mode == STREAM_PERSISTENT) return stream->persistent + offset;
+
+    stateBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+    return glMapBufferRange(GL_ARRAY_BUFFER, offset, bytes, GL_MAP_WRITE_BIT |
+                            GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+}
+
+GLintptr endStream(vertexStream *stream){
+    if (stream->mode != STREAM_PERSISTENT){
+        stateBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    if (stream->mode == STREAM_ORPHAN) return 0;
+    return stream->region * stream->regionSize;
+}
+
+void fenceStream(vertexStream *stream){
+    if (stream->mode == STREAM_ORPHAN) return;
+    stream->fences[stream->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stream->region = (stream->region + 1) % STREAM_REGIONS;
+}
+
+streamMode parseStreamMode(const char* name){
+    string mode = name;
+    if (mode == "auto") return STREAM_AUTO;
+    if (mode == "persistent") return STREAM_PERSISTENT;
+    if (mode == "unsynchronized") return STREAM_UNSYNCHRONIZED;
+    if (mode == "orphan") return STREAM_ORPHAN;
+    cerr << "Fatal: Unknown stream mode " << mode << endl;
+    exit(EXIT_FAILURE);
+}
+
+const char* streamModeName(streamMode mode){
+    switch (mode){
+        case STREAM_PERSISTENT: return "persistent";
+        case STREAM_UNSYNCHRONIZED: return "unsynchronized";
+        case STREAM_ORPHAN: return "orphan";
+        default: return "auto";
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <GL/glew.h>
+
+// Vertex data rewritten every frame. The buffer is split into regions used
+// round-robin, and each region is fenced after the draws that read it, so
+// the CPU never writes where the GPU is still reading and never waits on
+// an implicit sync either.
+enum streamMode {
+    STREAM_AUTO,           // Persistent where available, orphaning otherwise
+    STREAM_PERSISTENT,     // GL 4.4 / ARB_buffer_storage, mapped once
+    STREAM_UNSYNCHRONIZED, // glMapBufferRange per frame, guarded by fences
+    STREAM_ORPHAN          // glBufferData(NULL) per frame, the driver renames
+};
+
+static const int STREAM_REGIONS = 3;
+
+struct vertexStream {
+    streamMode mode;
+    GLuint buffer;
+    GLsizeiptr regionSize;
+    int region;
+    GLsync fences[STREAM_REGIONS];
+    char *persistent; // Whole mapping in persistent mode
+    unsigned long stalls; // Frames that had to wait for the GPU
+};
+
+void createStream(vertexStream *stream, GLsizeiptr bytesPerFrame, streamMode mode);
+void deleteStream(vertexStream *stream);
+
+// Returns where to write up to bytesPerFrame for this frame
+void* beginStream(vertexStream *stream, GLsizeiptr bytes);
+
+// Finishes the writes, returns the byte offset of the data in stream->buffer
+GLintptr endStream(vertexStream *stream);
+
+// Call after the draws that read this frame's data
+void fenceStream(vertexStream *stream);
+
+streamMode parseStreamMode(const char* name);
+const char* streamModeName(streamMode mode);
+
+#endif
@@ -0,0 +1,58 @@
+// Fills the texture cache ahead of time, so even the first run of the
+// template skips PNG decoding. Each PNG is loaded through the texture loader
+// on a headless context, which writes its mip chain to the cache. Files
+// whose cache is already fresh are left alone.
+//
+//   ./texcache [--texture-cache DIR] [--compress-textures] [--headless=osmesa] FILE.png...
+
+#ifdef WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#endif
+
+#include <GL/glew.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+#include "Context.h"
+#include "Render.h"
+#include "State.h"
+#include "TextureCache.h"
+#include "TextureLoader.h"
+
+using namespace std;
+
+int main(int argc, char *argv[]){
+    context.backend = BACKEND_EGL;
+    parseContextOptions(argc, argv);
+    parseTextureCacheOptions(argc, argv);
+
+    vector<const char*> files;
+    for (int i = 1; i < argc; i++){
+        string arg = argv[i];
+        if (arg == "--texture-cache" || arg == "--frames" || arg == "--output") i++;
+        else if (arg.compare(0, 2, "--") != 0) files.push_back(argv[i]);
+    }
+    if (files.empty()){
+        cerr << "Usage: " << argv[0] << " [--texture-cache DIR] [--compress-textures] FILE.png..." << endl;
+        return EXIT_FAILURE;
+    }
+
+    init();
+
+    // Decoded in parallel on the loader's workers
+    vector<GLuint> textures;
+    for (size_t i = 0; i < files.size(); i++) textures.push_back(loadTexture(files[i]));
+    finishTextures();
+
+    printTextureCacheStatistics(cout);
+    unsigned long written = textureCacheStatistics().stored + textureCacheStatistics().loaded;
+
+    stopTextureLoader();
+    stateDeleteTextures(textures.size(), textures.data());
+    destroyContext();
+    return written == files.size() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
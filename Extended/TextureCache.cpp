@@ -0,0 +1,387 @@
+#ifdef WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <direct.h>
+    #define makeDirectory(path) _mkdir(path)
+#else
+    #define makeDirectory(path) mkdir(path, 0755)
+#endif
+#include <sys/stat.h>
+
+#include <GL/glew.h>
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "MappedFile.h"
+#include "State.h"
+#include "TextureCache.h"
+
+using namespace std;
+
+// File layout: header, one textureCacheLevel per mip level, then the level
+// data, each level starting on a LEVEL_ALIGNMENT boundary
+struct textureCacheHeader {
+    char magic[4];
+    GLuint version;
+    GLuint64 sourceSize; // Of the PNG, to spot edits
+    GLint64 sourceTime;
+    GLsizei width;
+    GLsizei height;
+    GLuint levels;
+    GLenum internalFormat;
+    GLenum format;
+    GLenum type; // 0 for compressed levels
+};
+
+struct textureCacheLevel {
+    GLuint64 offset;
+    GLuint64 size;
+    GLsizei width;
+    GLsizei height;
+};
+
+static const char CACHE_MAGIC[4] = {'G', 'L', 'T', 'C'};
+static const GLuint CACHE_VERSION = 1;
+static const GLuint MAX_LEVELS = 32;
+static const size_t LEVEL_ALIGNMENT = 16;
+
+// A texture on its way into the cache: read back into buffer by the GPU,
+// then copied out and written by the writer thread
+struct cacheStore {
+    string file;
+    textureCacheHeader header;
+    vector<textureCacheLevel> levels; // offset is into buffer until written
+    GLuint buffer;
+    GLsync fence; // Signals once the chain is in buffer
+    vector< vector<GLubyte> > data;
+};
+
+static string cacheDirectory = "texturecache";
+static bool compressTextures = false;
+static textureCacheStats stats;
+
+static vector<cacheStore*> reading; // Only touched by the GL thread
+
+// The mutex guards writing, stopping and stats.stored
+static mutex storeMutex;
+static condition_variable storeQueued; // Wakes the writer
+static deque<cacheStore*> writing;
+static thread writer;
+static bool stopping = false;
+
+void parseTextureCacheOptions(int argc, char *argv[]){
+    for (int i = 1; i < argc; i++){
+        string arg = argv[i];
+        if (arg == "--compress-textures") compressTextures = true;
+        else if (arg == "--texture-cache" && i + 1 < argc){
+            cacheDirectory = argv[++i];
+            if (cacheDirectory == "none") cacheDirectory = "";
+        }
+    }
+}
+
+static bool compressionSupported(){
+    return compressTextures && GLEW_EXT_texture_compression_s3tc;
+}
+
+// One flat file per texture, named after its path
+static string cachePath(const char *file_name){
+    string name = file_name;
+    replace(name.begin(), name.end(), '/', '_');
+    replace(name.begin(), name.end(), '\\', '_');
+    replace(name.begin(), name.end(), ':', '_');
+    return cacheDirectory + "/" + name + ".gltc";
+}
+
+// Bytes of a width x height level in the formats storeCachedTexture writes,
+// 0 for any other format
+static GLuint64 levelSize(textureCacheHeader const* header, GLsizei width, GLsizei height){
+    GLuint64 blocks = (GLuint64)((width + 3) / 4) * ((height + 3) / 4);
+    if (header->type == 0 && header->format == GL_RGBA){
+        if (header->internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) return blocks * 8;
+        if (header->internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) return blocks * 16;
+    }
+    if (header->internalFormat == GL_RGBA8 && header->format == GL_RGBA && header->type == GL_UNSIGNED_BYTE)
+        return (GLuint64)width * height * 4;
+    return 0;
+}
+
+static const textureCacheHeader* validHeader(const char *file_name, mappedFile const& mapped){
+    if (mapped.size < sizeof(textureCacheHeader)) return NULL;
+    const textureCacheHeader *header = (const textureCacheHeader*)mapped.data;
+    if (memcmp(header->magic, CACHE_MAGIC, 4) != 0 || header->version != CACHE_VERSION) return NULL;
+
+    // Without the PNG there is nothing to be stale against
+    struct stat info;
+    if (stat(file_name, &info) == 0 &&
+        ((GLuint64)info.st_size != header->sourceSize || (GLint64)info.st_mtime != header->sourceTime))
+        return NULL;
+
+    if (header->levels == 0 || header->levels > MAX_LEVELS) return NULL;
+    if (mapped.size < sizeof(textureCacheHeader) + header->levels * sizeof(textureCacheLevel)) return NULL;
+    if (header->width <= 0 || header->height <= 0) return NULL;
+    GLsizei largest = max(header->width, header->height);
+    if (largest >> (header->levels - 1) != 1) return NULL; // The full chain, as stored
+
+    // The GL reads as many bytes as the sizes and format imply, whatever the
+    // level says, so every level must be exactly what the writer made
+    const textureCacheLevel *levels = (const textureCacheLevel*)(header + 1);
+    for (GLuint i = 0; i < header->levels; i++){
+        if (levels[i].width != max(header->width >> i, 1) || levels[i].height != max(header->height >> i, 1))
+            return NULL;
+        GLuint64 size = levelSize(header, levels[i].width, levels[i].height);
+        if (size == 0 || levels[i].size != size) return NULL;
+        if (levels[i].offset > mapped.size || levels[i].size > mapped.size - levels[i].offset) return NULL;
+    }
+
+    // Compressed levels need the extension, and asking for compression
+    // rebuilds an uncompressed cache
+    bool compressed = header->type == 0;
+    if (compressed ? !GLEW_EXT_texture_compression_s3tc : compressionSupported()) return NULL;
+    return header;
+}
+
+bool loadCachedTexture(const char *file_name, GLuint texture){
+    if (cacheDirectory.empty()) return false;
+
+    mappedFile mapped;
+    if (!mapFile(cachePath(file_name).c_str(), &mapped)) return false;
+
+    const textureCacheHeader *header = validHeader(file_name, mapped);
+    if (!header){
+        unmapFile(&mapped);
+        stats.rejected++;
+        return false;
+    }
+
+    // Client memory uploads, which the GL has copied by the time they return
+    stateBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    stateBindTexture(0, GL_TEXTURE_2D, texture);
+    const textureCacheLevel *levels = (const textureCacheLevel*)(header + 1);
+    size_t bytes = 0;
+    for (GLuint i = 0; i < header->levels; i++){
+        const unsigned char *data = mapped.data + levels[i].offset;
+        bytes += levels[i].size;
+        if (header->type == 0)
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, header->internalFormat, levels[i].width,
+                                   levels[i].height, 0, levels[i].size, data);
+        else
+            glTexImage2D(GL_TEXTURE_2D, i, header->internalFormat, levels[i].width, levels[i].height,
+                         0, header->format, header->type, data);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header->levels - 1);
+    stateTextureBytes(texture, bytes);
+
+    unmapFile(&mapped);
+    stats.loaded++;
+    return true;
+}
+
+// Re-uploads each RGBA8 level into a scratch texture with an S3TC internal
+// format and reads the driver's encoding back. Opaque textures use DXT1 at
+// half the size of DXT5.
+static bool compressLevels(textureCacheHeader *header, vector<textureCacheLevel> *levels,
+                           vector< vector<GLubyte> > *data){
+    bool opaque = true;
+    for (size_t i = 3; i < (*data)[0].size() && opaque; i += 4) opaque = (*data)[0][i] == 255;
+    GLenum internalFormat = opaque ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+
+    GLuint scratch;
+    stateGenTextures(1, &scratch, "texture compression");
+    stateBindTexture(0, GL_TEXTURE_2D, scratch);
+
+    vector< vector<GLubyte> > compressed(levels->size());
+    bool success = true;
+    for (size_t i = 0; i < levels->size() && success; i++){
+        textureCacheLevel &level = (*levels)[i];
+        glTexImage2D(GL_TEXTURE_2D, i, internalFormat, level.width, level.height, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, (*data)[i].data());
+
+        GLint isCompressed = 0, size = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, i, GL_TEXTURE_COMPRESSED, &isCompressed);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, i, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+        success = isCompressed && size > 0;
+        if (success){
+            compressed[i].resize(size);
+            glGetCompressedTexImage(GL_TEXTURE_2D, i, compressed[i].data());
+        }
+    }
+    stateDeleteTextures(1, &scratch);
+    if (!success) return false;
+
+    header->internalFormat = internalFormat;
+    header->format = GL_RGBA;
+    header->type = 0;
+    data->swap(compressed);
+    return true;
+}
+
+// Written aside and renamed, so a crash never leaves half a file behind
+static void writeCache(const char *file_name, textureCacheHeader const& header,
+                       vector<textureCacheLevel> *levels, vector< vector<GLubyte> > const& data){
+    size_t offset = sizeof(header) + levels->size() * sizeof(textureCacheLevel);
+    for (size_t i = 0; i < levels->size(); i++){
+        offset = (offset + LEVEL_ALIGNMENT - 1) / LEVEL_ALIGNMENT * LEVEL_ALIGNMENT;
+        (*levels)[i].offset = offset;
+        (*levels)[i].size = data[i].size();
+        offset += data[i].size();
+    }
+
+    makeDirectory(cacheDirectory.c_str());
+    string path = cachePath(file_name);
+    string temporary = path + ".tmp";
+    ofstream out(temporary.c_str(), ios::binary);
+    if (!out.is_open()){
+        cerr << "Could not write texture cache " << temporary << endl;
+        return;
+    }
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)levels->data(), levels->size() * sizeof(textureCacheLevel));
+    for (size_t i = 0; i < levels->size(); i++){
+        out.seekp((*levels)[i].offset);
+        out.write((const char*)data[i].data(), data[i].size());
+    }
+    out.close();
+
+    remove(path.c_str());
+    if (rename(temporary.c_str(), path.c_str()) != 0)
+        cerr << "Could not write texture cache " << path << endl;
+    else {
+        lock_guard<mutex> lock(storeMutex);
+        stats.stored++;
+    }
+}
+
+void storeCachedTexture(const char *file_name, GLuint texture){
+    struct stat info;
+    if (cacheDirectory.empty() || stat(file_name, &info) != 0) return;
+
+    cacheStore *store = new cacheStore();
+    store->file = file_name;
+    textureCacheHeader &header = store->header;
+    memcpy(header.magic, CACHE_MAGIC, 4);
+    header.version = CACHE_VERSION;
+    header.sourceSize = info.st_size;
+    header.sourceTime = info.st_mtime;
+    header.internalFormat = GL_RGBA8;
+    header.format = GL_RGBA;
+    header.type = GL_UNSIGNED_BYTE;
+
+    stateBindTexture(0, GL_TEXTURE_2D, texture);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &header.width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &header.height);
+
+    // Down to 1x1, as glGenerateMipmap left it
+    GLsizei largest = max(header.width, header.height);
+    header.levels = 1;
+    while (largest >> header.levels) header.levels++;
+
+    store->levels.resize(header.levels);
+    GLuint64 size = 0;
+    for (GLuint i = 0; i < header.levels; i++){
+        textureCacheLevel &level = store->levels[i];
+        level.width = max(header.width >> i, 1);
+        level.height = max(header.height >> i, 1);
+        level.offset = size;
+        level.size = (GLuint64)level.width * level.height * 4;
+        size += level.size;
+    }
+
+    // Queued behind the mip generation, nothing waits for it here
+    stateGenBuffers(1, &store->buffer, "texture cache readback");
+    stateBindBuffer(GL_PIXEL_PACK_BUFFER, store->buffer);
+    stateBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+    for (GLuint i = 0; i < header.levels; i++)
+        glGetTexImage(GL_TEXTURE_2D, i, GL_RGBA, GL_UNSIGNED_BYTE, (void*)store->levels[i].offset);
+    stateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    store->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    reading.push_back(store);
+}
+
+static void writerLoop(){
+    unique_lock<mutex> lock(storeMutex);
+    while (true){
+        storeQueued.wait(lock, []{ return stopping || !writing.empty(); });
+        if (writing.empty()) return; // Stopping, and every file is written
+
+        cacheStore *store = writing.front();
+        writing.pop_front();
+
+        lock.unlock();
+        writeCache(store->file.c_str(), store->header, &store->levels, store->data);
+        delete store;
+        lock.lock();
+    }
+}
+
+bool collectCachedStore(bool wait){
+    if (reading.empty()) return false;
+    cacheStore *store = reading.front();
+    GLenum status = glClientWaitSync(store->fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? GL_TIMEOUT_IGNORED : 0);
+    if (status == GL_TIMEOUT_EXPIRED) return false;
+    glDeleteSync(store->fence);
+    reading.erase(reading.begin());
+
+    GLuint64 size = store->levels.back().offset + store->levels.back().size;
+    stateBindBuffer(GL_PIXEL_PACK_BUFFER, store->buffer);
+    const GLubyte *mapped = (const GLubyte*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    bool success = mapped != NULL;
+    if (success){
+        store->data.resize(store->levels.size());
+        for (size_t i = 0; i < store->levels.size(); i++)
+            store->data[i].assign(mapped + store->levels[i].offset,
+                                  mapped + store->levels[i].offset + store->levels[i].size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    stateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    stateDeleteBuffers(1, &store->buffer);
+    if (!success){
+        cerr << "Could not read back " << store->file << " for the texture cache" << endl;
+        delete store;
+        return true;
+    }
+
+    // The driver encodes, so this part stays on the GL thread
+    if (compressionSupported() && !compressLevels(&store->header, &store->levels, &store->data))
+        cerr << "Could not compress " << store->file << ", caching it uncompressed" << endl;
+
+    lock_guard<mutex> lock(storeMutex);
+    if (!writer.joinable()){
+        stopping = false;
+        writer = thread(writerLoop);
+    }
+    writing.push_back(store);
+    storeQueued.notify_one();
+    return true;
+}
+
+void finishCachedStores(){
+    while (collectCachedStore(true));
+    if (!writer.joinable()) return;
+
+    unique_lock<mutex> lock(storeMutex);
+    stopping = true;
+    lock.unlock();
+    storeQueued.notify_all();
+    writer.join();
+}
+
+textureCacheStats const& textureCacheStatistics(){
+    return stats;
+}
+
+void printTextureCacheStatistics(ostream &out){
+    out << "Textures: " << stats.loaded << " loaded from "
+        << (cacheDirectory.empty() ? "(disabled)" : cacheDirectory) << ", " << stats.stored
+        << " cached, " << stats.rejected << " stale cache files" << endl;
+}
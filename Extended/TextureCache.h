@@ -0,0 +1,45 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <GL/glew.h>
+
+#include <ostream>
+
+// PNG textures kept on disk with their whole mip chain in the layout
+// glTexImage2D takes, so a later load is an mmap and one upload per level
+// straight from the mapping: no inflate, no copy and no glGenerateMipmap.
+// The PNG loader fills the cache the first time it uploads a file, reading
+// the chain back through a pixel pack buffer and writing it on a thread of
+// its own, so the render loop never waits on either. A cache file is only
+// used while the PNG's size and modification time match.
+struct textureCacheStats {
+    unsigned long loaded;   // Uploaded from the cache
+    unsigned long stored;   // Written after a PNG load
+    unsigned long rejected; // Stale, damaged or in a format the driver lacks
+};
+
+// --texture-cache DIR sets the directory (default "texturecache"),
+// --texture-cache none turns the cache off, and --compress-textures stores
+// S3TC levels where the driver has EXT_texture_compression_s3tc
+void parseTextureCacheOptions(int argc, char *argv[]);
+
+// Uploads the cached chain for file_name into texture, false if there is
+// no usable cache file for it
+bool loadCachedTexture(const char *file_name, GLuint texture);
+
+// Starts reading back the chain of a texture uploaded from file_name. It is
+// written once collectCachedStore has found the read done.
+void storeCachedTexture(const char *file_name, GLuint texture);
+
+// Hands the oldest finished read to the writer, compressing it first with
+// --compress-textures, or waits for it with wait set. Returns false if
+// nothing was handed on. updateTextures calls it within its budget.
+bool collectCachedStore(bool wait);
+
+// Writes everything started so far and stops the writer
+void finishCachedStores();
+
+textureCacheStats const& textureCacheStatistics();
+void printTextureCacheStatistics(std::ostream &out);
+
+#endif
@@ -0,0 +1,325 @@
+#ifdef WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#endif
+
+#include <GL/glew.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <limits>
+#include <cstdio>
+#include <cstdlib>
+
+#define PNG_DEBUG 3
+#define PNG_SIG_BYTES 8
+#include <png.h>
+
+#include "State.h"
+#include "TextureCache.h"
+#include "TextureLoader.h"
+
+using namespace std;
+
+enum jobState {
+    JOB_HEADER,  // Queued for a worker to read the size
+    JOB_SIZED,   // Waiting for the GL thread to map a buffer that fits
+    JOB_DECODE,  // Queued for a worker to decode into the mapped buffer
+    JOB_DECODED, // Waiting for the GL thread to upload
+    JOB_FAILED
+};
+
+struct textureJob {
+    string file;
+    GLuint texture;
+    jobState state;
+    png_uint_32 width;
+    png_uint_32 height;
+    GLuint pixelBuffer;
+    png_byte *pixels; // Mapped pixelBuffer, RGBA rows bottom-up
+};
+
+// Decoded textures are always 8-bit RGBA, so rows stay 4-byte aligned
+static const int TEXTURE_CHANNELS = 4;
+static const GLubyte PLACEHOLDER[TEXTURE_CHANNELS] = {128, 128, 128, 255};
+
+// The mutex guards the queue, stopping and every job's state. The rest of a
+// job belongs to whoever its state says is working on it.
+static mutex jobMutex;
+static condition_variable workQueued; // Wakes the workers
+static condition_variable workDone;   // Wakes finishTextures
+static deque<textureJob*> queue;
+static vector<textureJob*> jobs; // Unfinished loads, only touched by the GL thread
+static vector<thread> workers;
+static bool stopping = false;
+
+// Reads the size into width and height, and with pixels set also decodes the
+// image into it, failing if the size is not the one passed in. libpng reports
+// errors by longjmp, so nothing in here may need destructing.
+static bool readPNG(const char *file_name, png_uint_32 *width, png_uint_32 *height, png_byte *pixels){
+    FILE *fp = fopen(file_name, "rb");
+    if (!fp) return false;
+
+    png_byte header[PNG_SIG_BYTES];
+    if (fread(header, 1, PNG_SIG_BYTES, fp) != PNG_SIG_BYTES || png_sig_cmp(header, 0, PNG_SIG_BYTES)){
+        fclose(fp);
+        return false;
+    }
+
+    png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info_ptr = png_ptr ? png_create_info_struct(png_ptr) : NULL;
+    png_bytep *volatile row_pointers = NULL;
+    if (!info_ptr || setjmp(png_jmpbuf(png_ptr))){
+        png_destroy_read_struct(&png_ptr, info_ptr ? &info_ptr : NULL, NULL);
+        free(row_pointers);
+        fclose(fp);
+        return false;
+    }
+
+    png_init_io(png_ptr, fp);
+    png_set_sig_bytes(png_ptr, PNG_SIG_BYTES);
+    png_read_info(png_ptr, info_ptr);
+
+    png_uint_32 temp_width = png_get_image_width(png_ptr, info_ptr);
+    png_uint_32 temp_height = png_get_image_height(png_ptr, info_ptr);
+    bool sized = !pixels || (temp_width == *width && temp_height == *height);
+    *width = temp_width;
+    *height = temp_height;
+
+    if (pixels && sized){
+        png_set_expand(png_ptr);
+        png_set_strip_16(png_ptr);
+        png_set_gray_to_rgb(png_ptr);
+        png_set_filler(png_ptr, 0xFF, PNG_FILLER_AFTER);
+        png_read_update_info(png_ptr, info_ptr);
+
+        // OpenGL wants the bottom row first
+        row_pointers = (png_bytep*)malloc(temp_height * sizeof(png_bytep));
+        if (row_pointers){
+            for (png_uint_32 i = 0; i < temp_height; i++)
+                row_pointers[temp_height - 1 - i] = pixels + (size_t)i * temp_width * TEXTURE_CHANNELS;
+            png_read_image(png_ptr, row_pointers);
+        }
+    }
+
+    bool success = sized && (!pixels || row_pointers);
+    png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+    free(row_pointers);
+    fclose(fp);
+    return success;
+}
+
+static void workerLoop(){
+    unique_lock<mutex> lock(jobMutex);
+    while (true){
+        workQueued.wait(lock, []{ return stopping || !queue.empty(); });
+        if (stopping) return;
+
+        textureJob *job = queue.front();
+        queue.pop_front();
+        bool decode = job->state == JOB_DECODE;
+
+        lock.unlock();
+        bool success = readPNG(job->file.c_str(), &job->width, &job->height,
+                               decode ? job->pixels : NULL);
+        lock.lock();
+
+        job->state = !success ? JOB_FAILED : decode ? JOB_DECODED : JOB_SIZED;
+        workDone.notify_all();
+    }
+}
+
+void startTextureLoader(int threads){
+    if (!workers.empty()) return;
+    if (threads <= 0){
+        unsigned int hardware = thread::hardware_concurrency();
+        threads = hardware > 1 ? hardware - 1 : 1; // Leaves a core to the GL thread
+    }
+
+    stopping = false;
+    for (int i = 0; i < threads; i++) workers.push_back(thread(workerLoop));
+}
+
+static void releaseBuffer(textureJob *job){
+    if (!job->pixelBuffer) return;
+    stateBindBuffer(GL_PIXEL_UNPACK_BUFFER, job->pixelBuffer);
+    if (job->pixels) glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    stateBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    stateDeleteBuffers(1, &job->pixelBuffer);
+    job->pixelBuffer = 0;
+    job->pixels = NULL;
+}
+
+void stopTextureLoader(){
+    {
+        lock_guard<mutex> lock(jobMutex);
+        stopping = true;
+    }
+    workQueued.notify_all();
+    for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+    workers.clear();
+
+    finishCachedStores();
+    queue.clear();
+    for (size_t i = 0; i < jobs.size(); i++){
+        releaseBuffer(jobs[i]);
+        delete jobs[i];
+    }
+    jobs.clear();
+}
+
+GLuint loadTexture(const char *file_name){
+    GLuint texture;
+    stateGenTextures(1, &texture, "texture");
+    stateBindTexture(0, GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+    // A cached mip chain is ready at once, with no decode to wait for
+    if (loadCachedTexture(file_name, texture)) return texture;
+
+    startTextureLoader(0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, PLACEHOLDER);
+    stateTextureBytes(texture, TEXTURE_CHANNELS);
+
+    textureJob *job = new textureJob();
+    job->file = file_name;
+    job->texture = texture;
+    job->state = JOB_HEADER;
+    jobs.push_back(job);
+
+    lock_guard<mutex> lock(jobMutex);
+    queue.push_back(job);
+    workQueued.notify_one();
+    return texture;
+}
+
+static void mapBuffer(textureJob *job){
+    GLsizeiptr size = (GLsizeiptr)job->width * job->height * TEXTURE_CHANNELS;
+    stateGenBuffers(1, &job->pixelBuffer, "texture upload");
+    stateBindBuffer(GL_PIXEL_UNPACK_BUFFER, job->pixelBuffer);
+    stateBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+    job->pixels = (png_byte*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                              GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    stateBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0); // Client pointers elsewhere must stay pointers
+
+    lock_guard<mutex> lock(jobMutex);
+    if (job->pixels){
+        job->state = JOB_DECODE;
+        queue.push_back(job);
+        workQueued.notify_one();
+    } else {
+        job->state = JOB_FAILED;
+    }
+}
+
+static bool uploadTexture(textureJob *job){
+    stateBindBuffer(GL_PIXEL_UNPACK_BUFFER, job->pixelBuffer);
+    GLboolean intact = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    job->pixels = NULL;
+
+    if (intact){
+        stateBindTexture(0, GL_TEXTURE_2D, job->texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, job->width, job->height, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, (void*)0);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        stateTextureBytes(job->texture, (size_t)job->width * job->height * TEXTURE_CHANNELS * 4 / 3); // With the mips
+    }
+    releaseBuffer(job);
+    if (intact) storeCachedTexture(job->file.c_str(), job->texture);
+    return intact;
+}
+
+void updateTextures(double budgetMs){
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    bool uploaded = false;
+    auto spent = [&]{
+        return uploaded && chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() >= budgetMs;
+    };
+
+    for (size_t i = 0; i < jobs.size();){
+        if (spent()) return;
+
+        textureJob *job = jobs[i];
+        jobState state;
+        {
+            lock_guard<mutex> lock(jobMutex);
+            state = job->state;
+        }
+
+        if (state == JOB_SIZED){
+            mapBuffer(job);
+            continue; // Drops it right away if mapping failed
+        }
+        if (state == JOB_DECODED || state == JOB_FAILED){
+            if (state == JOB_FAILED || !uploadTexture(job)){
+                cerr << "Could not load texture " << job->file << ", keeping the placeholder" << endl;
+                releaseBuffer(job);
+            }
+            uploaded = true;
+            jobs.erase(jobs.begin() + i);
+            delete job;
+            continue;
+        }
+        i++;
+    }
+
+    // Cache files started by the uploads above, or in earlier frames, whose
+    // read back is done. Compressing one is the costly part.
+    while (!spent() && collectCachedStore(false)) uploaded = true;
+}
+
+bool textureReady(GLuint texture){
+    for (size_t i = 0; i < jobs.size(); i++)
+        if (jobs[i]->texture == texture) return false;
+    return true;
+}
+
+void finishTextures(){
+    while (true){
+        updateTextures(numeric_limits<double>::infinity());
+        if (jobs.empty()){
+            finishCachedStores();
+            return;
+        }
+
+        // Sleep until a worker hands something back to the GL thread
+        unique_lock<mutex> lock(jobMutex);
+        workDone.wait(lock, []{
+            for (size_t i = 0; i < jobs.size(); i++){
+                jobState state = jobs[i]->state;
+                if (state == JOB_SIZED || state == JOB_DECODED || state == JOB_FAILED) return true;
+            }
+            return false;
+        });
+    }
+}
+
+bool decodePNG(const char *file_name, GLsizei *width, GLsizei *height, vector<GLubyte> *pixels){
+    png_uint_32 w, h;
+    if (!readPNG(file_name, &w, &h, NULL)) return false;
+    pixels->resize((size_t)w * h * TEXTURE_CHANNELS);
+    if (!readPNG(file_name, &w, &h, pixels->data())) return false;
+
+    *width = w;
+    *height = h;
+    return true;
+}
+
+GLuint read_png_file(const char * file_name, int * width, int * height){
+    GLuint texture = loadTexture(file_name);
+    finishTextures();
+
+    stateBindTexture(0, GL_TEXTURE_2D, texture);
+    if (width) glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, width);
+    if (height) glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, height);
+    return texture;
+}
@@ -0,0 +1,42 @@
+#ifndef TEXTURELOADER_H
+#define TEXTURELOADER_H
+
+#include <GL/glew.h>
+
+#include <vector>
+
+// PNG textures loaded in the background. Worker threads decode straight
+// into mapped pixel unpack buffers, and the GL thread maps those buffers and
+// finishes the uploads in updateTextures, a few per frame. Every call here
+// except the workers' own is made on the GL thread.
+
+// Starts the workers, 0 picks one less than the hardware threads. loadTexture
+// starts them on first use, so this is only needed to pick the count.
+void startTextureLoader(int threads);
+
+// Joins the workers and drops the loads that have not finished
+void stopTextureLoader();
+
+// Returns a texture that can be bound at once. It holds a grey 1x1
+// placeholder until the PNG is uploaded, and keeps it if loading fails.
+// With a fresh file in the texture cache it is uploaded from there at once.
+GLuint loadTexture(const char *file_name);
+
+// Maps buffers for the workers and uploads decoded textures, then hands
+// finished texture cache reads to its writer, returning once budgetMs has
+// been spent. At least one upload is made per call.
+void updateTextures(double budgetMs);
+
+bool textureReady(GLuint texture);
+
+// Blocks until every texture that was asked for is uploaded and cached
+void finishTextures();
+
+// Loads through the same workers but waits for the upload
+GLuint read_png_file(const char * file_name, int * width, int * height);
+
+// Decodes on the calling thread into RGBA8 rows, bottom row first, for
+// callers that work on the pixels themselves
+bool decodePNG(const char *file_name, GLsizei *width, GLsizei *height, std::vector<GLubyte> *pixels);
+
+#endif
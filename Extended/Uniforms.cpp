@@ -0,0 +1,123 @@
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+#include "Render.h"
+#include "Resolution.h"
+#include "State.h"
+#include "Uniforms.h"
+
+using namespace std;
+
+static_assert(sizeof(frameUniforms) == 96, "frameUniforms must match the std140 Frame block");
+static_assert(sizeof(objectRecord) == OBJECT_TEXELS * 16, "objectRecord must be whole RGBA32F texels");
+
+static GLuint frameBuffer = 0;
+static GLint maxObjectTexels = 0; // GL_MAX_TEXTURE_BUFFER_SIZE, read once
+
+void bindProgramUniforms(GLuint program){
+    GLuint block = glGetUniformBlockIndex(program, "Frame");
+    if (block != GL_INVALID_INDEX) glUniformBlockBinding(program, block, FRAME_BINDING);
+    stateUniform1i(program, glGetUniformLocation(program, "uObjects"), OBJECT_TEXTURE_UNIT);
+    stateUniform1i(program, glGetUniformLocation(program, "uObjectTexels"), OBJECT_TEXELS);
+}
+
+void updateFrameUniforms(){
+    frameUniforms frame;
+    frame.mvp = MVP;
+    GLint w = scaledSize(width), h = scaledSize(height);
+    frame.viewport = glm::vec4((GLfloat)w, (GLfloat)h, 1.0f / w, 1.0f / h);
+    frame.pixelScale = renderScale;
+
+    if (frameBuffer == 0){
+        stateGenBuffers(1, &frameBuffer, "frame uniforms");
+        stateBindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+        stateBufferData(GL_UNIFORM_BUFFER, sizeof(frame), NULL, GL_DYNAMIC_DRAW);
+        stateBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BINDING, frameBuffer);
+    }
+    stateBindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frame), &frame);
+}
+
+void deleteFrameUniforms(){
+    stateDeleteBuffers(1, &frameBuffer);
+    frameBuffer = 0;
+}
+
+static void markDirty(struct objectBuffer *objects, GLuint index){
+    if (objects->dirtyBegin == objects->dirtyEnd){
+        objects->dirtyBegin = index;
+        objects->dirtyEnd = index + 1;
+        return;
+    }
+    objects->dirtyBegin = min(objects->dirtyBegin, index);
+    objects->dirtyEnd = max(objects->dirtyEnd, index + 1);
+}
+
+GLuint addObject(struct objectBuffer *objects, glm::mat4 const& model, glm::vec3 color){
+    objectRecord record;
+    record.model = model;
+    record.color = glm::vec4(color.x, color.y, color.z, 1.0f);
+    objects->records.push_back(record);
+    GLuint index = objects->records.size() - 1;
+    markDirty(objects, index);
+    return index;
+}
+
+void setObjectModel(struct objectBuffer *objects, GLuint index, glm::mat4 const& model){
+    objects->records[index].model = model;
+    markDirty(objects, index);
+}
+
+void updateObjectBuffer(struct objectBuffer *objects){
+    if (objects->buffer == 0){
+        stateGenBuffers(1, &objects->buffer, "object buffer");
+        stateGenTextures(1, &objects->texture, "object buffer");
+    }
+    stateBindBuffer(GL_TEXTURE_BUFFER, objects->buffer);
+
+    // Grows by doubling, up to what a buffer texture can address. The
+    // texture sees the new storage without being attached again.
+    if (maxObjectTexels == 0) glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxObjectTexels);
+    GLuint maxRecords = maxObjectTexels / OBJECT_TEXELS;
+    GLuint count = objects->records.size();
+    if (count > maxRecords){
+        cerr << "Fatal: " << count << " object records, the buffer texture holds " << maxRecords << endl;
+        exit(EXIT_FAILURE);
+    }
+    if (count > objects->capacity){
+        bool attached = objects->capacity > 0;
+        objects->capacity = min(max(count, objects->capacity * 2), maxRecords);
+        stateBufferData(GL_TEXTURE_BUFFER, objects->capacity * sizeof(objectRecord), NULL, GL_DYNAMIC_DRAW);
+        objects->dirtyBegin = 0;
+        objects->dirtyEnd = count;
+        if (!attached){
+            stateBindTexture(OBJECT_TEXTURE_UNIT, GL_TEXTURE_BUFFER, objects->texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, objects->buffer);
+        }
+    } else if (count > 0 && objects->dirtyBegin == 0 && objects->dirtyEnd == count){
+        // Every record changed, so orphan the storage rather than wait for
+        // the draws still reading it
+        stateBufferData(GL_TEXTURE_BUFFER, objects->capacity * sizeof(objectRecord), NULL, GL_DYNAMIC_DRAW);
+    }
+
+    if (objects->dirtyBegin < objects->dirtyEnd){
+        glBufferSubData(GL_TEXTURE_BUFFER, objects->dirtyBegin * sizeof(objectRecord),
+                        (objects->dirtyEnd - objects->dirtyBegin) * sizeof(objectRecord),
+                        &objects->records[objects->dirtyBegin]);
+    }
+    objects->dirtyBegin = objects->dirtyEnd = 0;
+    stateBindTexture(OBJECT_TEXTURE_UNIT, GL_TEXTURE_BUFFER, objects->texture);
+}
+
+void deleteObjectBuffer(struct objectBuffer *objects){
+    stateDeleteBuffers(1, &objects->buffer);
+    stateDeleteTextures(1, &objects->texture);
+    objects->buffer = objects->texture = 0;
+    objects->records.clear();
+    objects->capacity = 0;
+    objects->dirtyBegin = objects->dirtyEnd = 0;
+}
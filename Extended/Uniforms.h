@@ -0,0 +1,74 @@
+#ifndef UNIFORMS_H
+#define UNIFORMS_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Uniform data shared by every program. Each vertex shader declares
+//
+//   layout(std140) uniform Frame {
+//       mat4 MVP;
+//       vec4 viewport;    // width, height, 1 / width, 1 / height of the render target
+//       float pixelScale; // Render target pixels per window pixel, Resolution.h
+//   };
+//
+// which is filled once per frame by updateFrameUniforms, instead of every
+// program taking its own copy of the matrix.
+//
+// Per-object data lives in an objectBuffer, read through a buffer texture
+// by colorObject.vert. Moving any number of objects then costs one buffer
+// update a frame, and no vertex uploads.
+
+static const GLuint FRAME_BINDING = 0; // Uniform buffer binding of the Frame block
+static const GLuint OBJECT_TEXTURE_UNIT = 1; // Where the object buffer is bound, unit 0 is for textures
+
+// The Frame block, laid out as std140
+struct frameUniforms {
+    glm::mat4 mvp;
+    glm::vec4 viewport;
+    GLfloat pixelScale;
+    GLfloat padding[3]; // std140 rounds the block up to a vec4
+};
+
+// Points the program's Frame block and uObjects sampler at their bindings.
+// Programs from compileShaderAsync get this once they have linked.
+void bindProgramUniforms(GLuint program);
+
+// Copies MVP and the viewport into the Frame block. Call once a frame,
+// before drawing and after changing MVP.
+void updateFrameUniforms();
+void deleteFrameUniforms();
+
+// One object's record, OBJECT_TEXELS RGBA32F texels: the model matrix by
+// column, then the color
+struct objectRecord {
+    glm::mat4 model;
+    glm::vec4 color;
+};
+
+static const int OBJECT_TEXELS = sizeof(objectRecord) / sizeof(glm::vec4);
+
+// Holds at most GL_MAX_TEXTURE_BUFFER_SIZE / OBJECT_TEXELS records. GL 3.3
+// only guarantees 65536 texels, so 13107 records; texelFetch past the end
+// returns 0.
+struct objectBuffer {
+    GLuint buffer;
+    GLuint texture; // GL_TEXTURE_BUFFER over buffer
+    std::vector<objectRecord> records;
+    GLuint capacity; // Records buffer has room for
+    GLuint dirtyBegin, dirtyEnd; // Records changed since the last update
+};
+
+// Returns the new record's index, for arrayObject::objectIndex
+GLuint addObject(struct objectBuffer *objects, glm::mat4 const& model, glm::vec3 color);
+void setObjectModel(struct objectBuffer *objects, GLuint index, glm::mat4 const& model);
+
+// Uploads the changed records with one call and binds the buffer to
+// OBJECT_TEXTURE_UNIT. Call once a frame, before drawing the objects. Fails
+// with more records than the buffer texture can hold.
+void updateObjectBuffer(struct objectBuffer *objects);
+void deleteObjectBuffer(struct objectBuffer *objects);
+
+#endif
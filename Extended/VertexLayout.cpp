@@ -0,0 +1,114 @@
+#include <GL/glew.h>
+#include <glm/gtc/packing.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <assert.h>
+
+#include "VertexLayout.h"
+
+using namespace std;
+
+static GLuint attributeSize(vertexAttribute const& attribute){
+    switch (attribute.type){
+        case GL_FLOAT: return attribute.components * sizeof(GLfloat);
+        default:       return attribute.components * sizeof(GLshort);
+    }
+}
+
+vertexLayout makeLayout(initializer_list<vertexAttribute> attributes){
+    assert(attributes.size() <= (size_t)MAX_LAYOUT_ATTRIBUTES && "Too many attributes for a layout");
+
+    vertexLayout layout;
+    layout.count = 0;
+    layout.stride = 0;
+    for (initializer_list<vertexAttribute>::iterator it = attributes.begin(); it != attributes.end(); ++it){
+        vertexAttribute attribute = *it;
+        attribute.offset = layout.stride;
+        layout.stride += (attributeSize(attribute) + 3) & ~3;
+        layout.attributes[layout.count++] = attribute;
+    }
+    return layout;
+}
+
+const vertexLayout positionLayout = makeLayout({{0, 3, GL_FLOAT, GL_FALSE}});
+const vertexLayout compactPositionLayout = makeLayout({{0, 2, GL_FLOAT, GL_FALSE}});
+const vertexLayout textureLayout = makeLayout({{0, 3, GL_FLOAT, GL_FALSE},
+                                               {1, 2, GL_FLOAT, GL_FALSE}});
+const vertexLayout compactTextureLayout = makeLayout({{0, 2, GL_FLOAT, GL_FALSE},
+                                                      {1, 2, GL_UNSIGNED_SHORT, GL_TRUE}});
+const vertexLayout halfTextureLayout = makeLayout({{0, 2, GL_FLOAT, GL_FALSE},
+                                                   {1, 2, GL_HALF_FLOAT, GL_FALSE}});
+
+// Writes one attribute of every vertex, so the type is only switched on once
+static void packAttribute(vertexAttribute const& attribute, GLsizei stride, unsigned char *out,
+                          const GLfloat *source, int sourceStride, GLuint count){
+    GLint components = attribute.components;
+    switch (attribute.type){
+        case GL_FLOAT:
+            for (GLuint v = 0; v < count; v++, out += stride, source += sourceStride)
+                memcpy(out, source, components * sizeof(GLfloat));
+            break;
+        case GL_HALF_FLOAT:
+            for (GLuint v = 0; v < count; v++, out += stride, source += sourceStride){
+                GLushort half[4];
+                for (GLint c = 0; c < components; c++) half[c] = glm::packHalf1x16(source[c]);
+                memcpy(out, half, components * sizeof(GLushort));
+            }
+            break;
+        case GL_UNSIGNED_SHORT: {
+            GLfloat scale = attribute.normalized ? 65535.0f : 1.0f;
+            for (GLuint v = 0; v < count; v++, out += stride, source += sourceStride){
+                GLushort packed[4];
+                for (GLint c = 0; c < components; c++){
+                    GLfloat value = source[c] * scale;
+                    assert(value >= 0.0f && value <= 65535.0f && "Value does not fit GL_UNSIGNED_SHORT, normalized holds 0..1");
+                    packed[c] = (GLushort)(value + 0.5f);
+                }
+                memcpy(out, packed, components * sizeof(GLushort));
+            }
+            break;
+        }
+        case GL_SHORT: {
+            GLfloat scale = attribute.normalized ? 32767.0f : 1.0f;
+            for (GLuint v = 0; v < count; v++, out += stride, source += sourceStride){
+                GLshort packed[4];
+                for (GLint c = 0; c < components; c++){
+                    GLfloat value = source[c] * scale;
+                    assert(value >= -32768.0f && value <= 32767.0f && "Value does not fit GL_SHORT, normalized holds -1..1");
+                    packed[c] = (GLshort)lround(value);
+                }
+                memcpy(out, packed, components * sizeof(GLshort));
+            }
+            break;
+        }
+        default:
+            assert(false && "Unsupported attribute type");
+    }
+}
+
+void packVertices(vertexLayout const& layout, void *out, const GLfloat *const *sources,
+                  const int *strides, GLuint count){
+    unsigned char *vertices = (unsigned char*)out;
+    for (int a = 0; a < layout.count; a++){
+        vertexAttribute const& attribute = layout.attributes[a];
+        packAttribute(attribute, layout.stride, vertices + attribute.offset, sources[a], strides[a], count);
+
+        // Padding stays defined, written once so mapped memory is not read
+        GLuint size = attributeSize(attribute);
+        GLuint end = a + 1 < layout.count ? layout.attributes[a + 1].offset : layout.stride;
+        if (attribute.offset + size == end) continue;
+        for (GLuint v = 0; v < count; v++)
+            memset(vertices + (size_t)v * layout.stride + attribute.offset + size, 0, end - attribute.offset - size);
+    }
+}
+
+void setVertexAttributes(vertexLayout const& layout, GLintptr offset){
+    for (int a = 0; a < layout.count; a++){
+        vertexAttribute const& attribute = layout.attributes[a];
+        glVertexAttribPointer(attribute.location, attribute.components, attribute.type,
+                              attribute.normalized, layout.stride,
+                              (void*)(offset + attribute.offset));
+        glEnableVertexAttribArray(attribute.location);
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef VERTEXLAYOUT_H
+#define VERTEXLAYOUT_H
+
+#include <GL/glew.h>
+
+#include <initializer_list>
+
+// How vertices are packed into one interleaved buffer. Geometry is still
+// built as floats, and uploadArray packs it into the object's layout, so a
+// smaller type only costs precision, never code that builds the geometry.
+struct vertexAttribute {
+    GLuint location;      // Shader input
+    GLint components;
+    GLenum type;          // GL_FLOAT, GL_HALF_FLOAT, GL_SHORT or GL_UNSIGNED_SHORT
+    GLboolean normalized; // Integers read as -1..1 or 0..1
+    GLuint offset;        // Bytes into the vertex, set by makeLayout
+};
+
+static const int MAX_LAYOUT_ATTRIBUTES = 4;
+
+struct vertexLayout {
+    vertexAttribute attributes[MAX_LAYOUT_ATTRIBUTES];
+    int count;
+    GLsizei stride;
+};
+
+// Places the attributes in order, each on a 4-byte boundary
+vertexLayout makeLayout(std::initializer_list<vertexAttribute> attributes);
+
+// Position xyz as floats, 12 bytes, what arrayObject uses by default
+extern const vertexLayout positionLayout;
+// Position xy as floats, 8 bytes. The shaders read z as 0, so this only
+// suits flat geometry.
+extern const vertexLayout compactPositionLayout;
+// Position xyz and UV as floats, 20 bytes
+extern const vertexLayout textureLayout;
+// Position xy as floats and UV as normalized 16-bit integers, 12 bytes.
+// The UVs must lie in 0..1.
+extern const vertexLayout compactTextureLayout;
+// Position xy as floats and UV as half floats, 12 bytes, for UVs that tile
+extern const vertexLayout halfTextureLayout;
+
+// Packs count vertices into out, layout.stride bytes apart. Attribute i is
+// read from sources[i], which advances strides[i] floats per vertex; source
+// components beyond the attribute's are dropped.
+void packVertices(vertexLayout const& layout, void *out, const GLfloat *const *sources,
+                  const int *strides, GLuint count);
+
+// Points the attributes at the bound GL_ARRAY_BUFFER, offset bytes in, and
+// enables them. Call with the VAO bound.
+void setVertexAttributes(vertexLayout const& layout, GLintptr offset);
+
+#endif
@@ -1,7 +1,7 @@
 #version 330 core
 
 layout(location = 0) out vec4 colourOut;
-uniform vec3 uColorVec;
+in vec3 fragColor;
 void main() {
-    colourOut = vec4(uColorVec, 1.0);
+    colourOut = vec4(fragColor, 1.0);
 }
\ No newline at end of file
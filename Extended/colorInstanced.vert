@@ -0,0 +1,19 @@
+#version 330 core
+
+layout(location = 0) in vec3 vertPosition;
+layout(location = 2) in vec3 vertColor;       // Per instance
+layout(location = 3) in vec2 instanceOffset;  // Per instance
+layout(location = 4) in float instanceScale;  // Per instance
+layout(std140) uniform Frame { // Uniforms.h, shared by every program
+    mat4 MVP;
+    vec4 viewport;
+    float pixelScale;
+};
+out vec3 fragColor;
+
+void main() {
+    vec2 position = vertPosition.xy * instanceScale + instanceOffset;
+    gl_Position = MVP * vec4(position, vertPosition.z, 1.0);
+    gl_PointSize = 20.0f * instanceScale * pixelScale;
+    fragColor = vertColor;
+}
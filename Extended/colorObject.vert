@@ -0,0 +1,21 @@
+#version 330 core
+
+layout(location = 0) in vec3 vertPosition;
+layout(std140) uniform Frame { // Uniforms.h, shared by every program
+    mat4 MVP;
+    vec4 viewport;
+    float pixelScale;
+};
+uniform samplerBuffer uObjects; // An objectBuffer
+uniform int uObjectTexels; // Per record, OBJECT_TEXELS in Uniforms.h
+uniform int uObject; // Set per draw, instances read the records after it
+out vec3 fragColor;
+
+void main() {
+    int base = (uObject + gl_InstanceID) * uObjectTexels;
+    mat4 model = mat4(texelFetch(uObjects, base), texelFetch(uObjects, base + 1),
+                      texelFetch(uObjects, base + 2), texelFetch(uObjects, base + 3));
+    gl_Position = MVP * model * vec4(vertPosition.xyz, 1.0);
+    gl_PointSize = 20.0f * pixelScale;
+    fragColor = texelFetch(uObjects, base + uObjectTexels - 1).rgb;
+}
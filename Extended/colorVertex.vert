@@ -1,9 +1,16 @@
 #version 330 core
 
 layout(location = 0) in vec3 vertPosition;
-uniform mat4 uModelMatrix;
+layout(location = 2) in vec3 vertColor; // Per vertex when batched, constant otherwise
+layout(std140) uniform Frame { // Uniforms.h, shared by every program
+    mat4 MVP;
+    vec4 viewport;
+    float pixelScale;
+};
+out vec3 fragColor;
 
 void main() {
-    gl_Position = uModelMatrix * vec4(vertPosition.xyz, 1.0);
-    gl_PointSize = 20.0f;
+    gl_Position = MVP * vec4(vertPosition.xyz, 1.0);
+    gl_PointSize = 20.0f * pixelScale;
+    fragColor = vertColor;
 }
@@ -0,0 +1,17 @@
+#version 330 core
+
+layout(location = 0) in vec3 vertPosition;
+layout(location = 2) in vec3 vertColor; // Constant
+layout(std140) uniform Frame { // Uniforms.h, shared by every program
+    mat4 MVP;
+    vec4 viewport;
+    float pixelScale;
+};
+uniform float uPointSize; // Set per tree node by drawPointCloud
+out vec3 fragColor;
+
+void main() {
+    gl_Position = MVP * vec4(vertPosition.xyz, 1.0);
+    gl_PointSize = uPointSize * pixelScale;
+    fragColor = vertColor;
+}
@@ -0,0 +1,16 @@
+#version 330 core
+
+// Interpolated values from the vertex shaders
+in vec3 UV;
+
+// Ouput data
+out vec3 color;
+
+// Values that stay constant for the whole mesh.
+uniform sampler2DArray myTextureSampler;
+
+void main(){
+
+    // Output color = color of the texture at the specified UV and layer
+    color = texture( myTextureSampler, UV ).rgb;
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#version 330 core
+
+// Input vertex data, different for all executions of this shader.
+layout(location = 0) in vec3 vertexPosition_modelspace;
+layout(location = 1) in vec2 vertexUV;
+layout(location = 2) in float vertexLayer; // Atlas layer
+
+// Output data ; will be interpolated for each fragment.
+out vec3 UV;
+
+// Values that stay constant for the whole frame, shared by every program.
+layout(std140) uniform Frame {
+    mat4 MVP;
+    vec4 viewport;
+    float pixelScale;
+};
+
+void main(){
+
+    // Output position of the vertex, in clip space : MVP * position
+    gl_Position =  MVP * vec4(vertexPosition_modelspace,1);
+
+    // UV of the vertex, with the layer it samples from.
+    UV = vec3(vertexUV, vertexLayer);
+}
@@ -0,0 +1,29 @@
+#version 330 core
+
+// Input vertex data, different for all executions of this shader.
+layout(location = 0) in vec3 vertexPosition_modelspace;
+layout(location = 1) in vec2 vertexUV;
+
+// Input instance data, different for every instance.
+layout(location = 3) in vec2 instanceOffset;
+layout(location = 4) in float instanceScale;
+
+// Output data ; will be interpolated for each fragment.
+out vec2 UV;
+
+// Values that stay constant for the whole frame, shared by every program.
+layout(std140) uniform Frame {
+    mat4 MVP;
+    vec4 viewport;
+    float pixelScale;
+};
+
+void main(){
+
+    // Scale and move the shared geometry into place for this instance
+    vec2 position = vertexPosition_modelspace.xy * instanceScale + instanceOffset;
+    gl_Position =  MVP * vec4(position, vertexPosition_modelspace.z, 1);
+
+    // UV of the vertex. No special space for this one.
+    UV = vertexUV;
+}
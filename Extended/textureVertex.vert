@@ -7,8 +7,12 @@ layout(location = 1) in vec2 vertexUV;
 // Output data ; will be interpolated for each fragment.
 out vec2 UV;
 
-// Values that stay constant for the whole mesh.
-uniform mat4 MVP;
+// Values that stay constant for the whole frame, shared by every program.
+layout(std140) uniform Frame {
+    mat4 MVP;
+    vec4 viewport;
+    float pixelScale;
+};
 
 void main(){
 
@@ -23,6 +23,9 @@
 #include <string>
 #include <fstream>
 #include <assert.h>
+
+#include "Profiler.h"
+
 using namespace std;
 
 GLint width = 1024;
@@ -71,7 +74,7 @@ static void drawArray(struct arrayObject *obj){
 
     glBindBuffer(GL_ARRAY_BUFFER, obj->vertexBuffer);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-    glDrawArrays(obj->mode, 0, obj->vertexArrayLength);
+    glDrawArrays(obj->mode, 0, obj->vertexArrayLength / 3);
 }
 
 static void getUniform(struct arrayObject *obj){
@@ -180,6 +183,7 @@ GLuint compileShader(string const& vs, string const& fs){
 }
 
 int main(int argc, char *argv[]){
+    parseProfilerOptions(argc, argv);
     init(); // Set OpenGL settings
 
     // Load shaders
@@ -215,15 +219,18 @@ int main(int argc, char *argv[]){
     // main loop
     while(!glfwWindowShouldClose(window))
     {
-        glfwPollEvents();
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        profilerBeginFrame();
+        { PROFILE_ZONE("poll"); glfwPollEvents(); }
+        { PROFILE_ZONE("clear"); glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); }
         glEnableVertexAttribArray(0);
 
-        drawArray(&dots);
+        { PROFILE_ZONE("drawArray dots"); drawArray(&dots); }
 
         glDisableVertexAttribArray(0);
-        glfwSwapBuffers(window);
+        { PROFILE_ZONE("swap"); glfwSwapBuffers(window); }
+        profilerEndFrame();
     }
+    profilerWrite();
 
     // Clean up
     glDeleteVertexArrays(1, &VertexArrayID);